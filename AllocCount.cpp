@@ -0,0 +1,110 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "AllocCount.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/**
+ * The number of HotPath objects alive on the thread. A plain thread local
+ * integer needs no construction, so it is usable by allocations made before
+ * main() runs.
+ */
+static thread_local int hotDepth = 0;
+
+/**
+ * The allocations made with a non-zero hotDepth.
+ */
+static std::atomic<std::uint64_t> hotAllocs(0);
+
+AllocCount::HotPath::HotPath() {
+	++hotDepth;
+}
+
+AllocCount::HotPath::~HotPath() {
+	--hotDepth;
+}
+
+std::uint64_t AllocCount::hot() {
+	return hotAllocs.load(std::memory_order_relaxed);
+}
+
+void AllocCount::reset() {
+	hotAllocs.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Allocates like the default operator new, counting allocations on the input
+ * path.
+ */
+static void *allocate(std::size_t size) {
+	if (hotDepth) {
+		hotAllocs.fetch_add(1, std::memory_order_relaxed);
+	}
+	void *ptr;
+	while (!(ptr = std::malloc(size ? size : 1))) {
+		std::new_handler nh = std::get_new_handler();
+		if (!nh) {
+			throw std::bad_alloc();
+		}
+		nh();
+	}
+	return ptr;
+}
+
+void *operator new(std::size_t size) {
+	return allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+	return allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+	try {
+		return allocate(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+	try {
+		return allocate(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+	std::free(ptr);
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef ALLOCCOUNT_HPP
+#define ALLOCCOUNT_HPP
+
+#include <cstdint>
+
+/**
+ * Counts heap allocations made while handling input. Once the program is
+ * running, reading, translating, and writing a touch frame should never
+ * allocate, so that the time taken is predictable and a long running process
+ * does not fragment its heap. The global operator new is replaced by one that
+ * counts its calls made within a HotPath on any thread; it otherwise uses
+ * malloc() like the default.
+ *
+ * Allocations made by C libraries with malloc() are not counted.
+ * @author  Jeff Jackowski
+ */
+class AllocCount {
+public:
+	/**
+	 * Marks the code run during its life as part of the input path. Nesting
+	 * is allowed.
+	 */
+	class HotPath {
+	public:
+		HotPath();
+		~HotPath();
+		HotPath(const HotPath &) = delete;
+		HotPath &operator = (const HotPath &) = delete;
+	};
+	/**
+	 * The number of allocations made within a HotPath since the program
+	 * started, or since the last call to reset().
+	 */
+	static std::uint64_t hot();
+	/**
+	 * Sets the count returned by hot() back to zero. Used after a warm-up,
+	 * since the first uses of some code are allowed to allocate things like
+	 * buffers that are then kept.
+	 */
+	static void reset();
+};
+
+#endif        //  #ifndef ALLOCCOUNT_HPP
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Calibrator.hpp"
+#include <cmath>
+#include <iostream>
+
+/**
+ * The display locations, in normalized coordinates, that the user is asked
+ * to touch. They are a tenth of the display's size in from each edge because
+ * touches at the very edges are often clipped or hard to place precisely.
+ */
+static const double targets[4][2] = {
+	{ 0.1, 0.1 }, { 0.9, 0.1 }, { 0.1, 0.9 }, { 0.9, 0.9 }
+};
+
+static const char *targetNames[4] = {
+	"top left", "top right", "bottom left", "bottom right"
+};
+
+Calibrator::Calibrator(Evdev &ev) :
+inX(*ev.absInfo(ABS_MT_POSITION_X)), inY(*ev.absInfo(ABS_MT_POSITION_Y)),
+points(0), x(0), y(0), contacts(0), lifted(false) {
+	conns[0] = ev.inputConnect(
+		EventTypeCode(EV_ABS, ABS_MT_TRACKING_ID),
+		std::bind(&Calibrator::trackEvent, this, std::placeholders::_2)
+	);
+	conns[1] = ev.inputConnect(
+		EventTypeCode(EV_ABS, ABS_MT_POSITION_X),
+		[this](EventTypeCode, std::int32_t val) { x = val; }
+	);
+	conns[2] = ev.inputConnect(
+		EventTypeCode(EV_ABS, ABS_MT_POSITION_Y),
+		[this](EventTypeCode, std::int32_t val) { y = val; }
+	);
+	conns[3] = ev.inputConnect(
+		EventTypeCode(EV_SYN, SYN_REPORT),
+		std::bind(&Calibrator::synEvent, this)
+	);
+	std::cout << "Calibrating. Touch near each corner of the display with one"
+	" finger, a tenth of the display's width and height in from the edges, as"
+	" precisely as possible." << std::endl;
+	prompt();
+}
+
+void Calibrator::prompt() const {
+	std::cout << "Touch near the " << targetNames[points] << " corner." <<
+	std::endl;
+}
+
+void Calibrator::trackEvent(std::int32_t val) {
+	if (val < 0) {
+		if (contacts && !--contacts) {
+			lifted = true;
+		}
+	} else {
+		++contacts;
+	}
+}
+
+void Calibrator::synEvent() {
+	if (lifted && !done()) {
+		lifted = false;
+		rawX[points] = x;
+		rawY[points] = y;
+		std::cout << "Recorded " << x << ", " << y << '.' << std::endl;
+		if (++points < numPoints) {
+			prompt();
+		}
+	}
+}
+
+Transform::Matrix Calibrator::result() const {
+	// least squares fit of an affine map from normalized touchscreen
+	// coordinates to the targets using the normal equations
+	double ix = std::max(inX.maximum - inX.minimum, 1);
+	double iy = std::max(inY.maximum - inY.minimum, 1);
+	double a[3][3] = { }, bx[3] = { }, by[3] = { };
+	for (int i = 0; i < numPoints; ++i) {
+		double row[3] = {
+			(rawX[i] - inX.minimum) / ix,
+			(rawY[i] - inY.minimum) / iy,
+			1
+		};
+		for (int r = 0; r < 3; ++r) {
+			for (int c = 0; c < 3; ++c) {
+				a[r][c] += row[r] * row[c];
+			}
+			bx[r] += row[r] * targets[i][0];
+			by[r] += row[r] * targets[i][1];
+		}
+	}
+	auto det = [](const double m[3][3]) {
+		return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+			m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+			m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	};
+	double d = det(a);
+	if (std::abs(d) < 1e-9) {
+		BOOST_THROW_EXCEPTION(CalibrationError());
+	}
+	Transform::Matrix norm;
+	// Cramer's rule
+	for (int c = 0; c < 3; ++c) {
+		double m[3][3];
+		for (int r = 0; r < 3; ++r) {
+			for (int k = 0; k < 3; ++k) {
+				m[r][k] = (k == c) ? bx[r] : a[r][k];
+			}
+		}
+		norm[c] = det(m) / d;
+		for (int r = 0; r < 3; ++r) {
+			m[r][c] = by[r];
+		}
+		norm[3 + c] = det(m) / d;
+	}
+	return norm;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef CALIBRATOR_HPP
+#define CALIBRATOR_HPP
+
+#include "Evdev.hpp"
+#include "Transform.hpp"
+
+struct CalibrationError : TransformError { };
+
+/**
+ * Guides the user through touching locations near the corners of the display
+ * to find a calibration matrix for Transform. The touchscreen's input is used only
+ * by this object while calibration is in progress.
+ * @author  Jeff Jackowski
+ */
+class Calibrator : boost::noncopyable {
+	/**
+	 * The number of locations the user is asked to touch.
+	 */
+	static constexpr int numPoints = 4;
+	/**
+	 * Connections to the touchscreen's input signals; disconnected when
+	 * this object is destroyed.
+	 */
+	boost::signals2::scoped_connection conns[4];
+	/**
+	 * The range of the touchscreen's X axis.
+	 */
+	input_absinfo inX;
+	/**
+	 * The range of the touchscreen's Y axis.
+	 */
+	input_absinfo inY;
+	/**
+	 * The recorded locations in touchscreen coordinates.
+	 */
+	int rawX[numPoints], rawY[numPoints];
+	/**
+	 * The number of recorded locations.
+	 */
+	int points;
+	/**
+	 * The most recent location.
+	 */
+	int x, y;
+	/**
+	 * The number of contacts.
+	 */
+	int contacts;
+	/**
+	 * True when the last contact has been lifted and the location should be
+	 * recorded.
+	 */
+	bool lifted;
+	void trackEvent(std::int32_t val);
+	void synEvent();
+	/**
+	 * Tells the user where to touch next.
+	 */
+	void prompt() const;
+public:
+	/**
+	 * Starts calibration by asking the user to touch the first location.
+	 */
+	Calibrator(Evdev &ev);
+	/**
+	 * True once all locations have been recorded.
+	 */
+	bool done() const {
+		return points == numPoints;
+	}
+	/**
+	 * Finds the matrix on normalized coordinates that best maps the touched
+	 * locations to the requested display locations.
+	 * @pre  done() is true.
+	 * @throw CalibrationError  The touched locations cannot be used; they
+	 *                          may be too close together.
+	 */
+	Transform::Matrix result() const;
+};
+
+#endif        //  #ifndef CALIBRATOR_HPP
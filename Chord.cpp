@@ -0,0 +1,85 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Chord.hpp"
+#include <sstream>
+
+/**
+ * Fills in an event; the kernel supplies the time.
+ */
+static void encode(input_event &ie, int type, int code, std::int32_t value) {
+	ie.input_event_sec = 0;
+	ie.input_event_usec = 0;
+	ie.type = type;
+	ie.code = code;
+	ie.value = value;
+}
+
+Chord::Chord(const std::uint16_t *keys, int count) {
+	if (count > maxKeys) {
+		count = maxKeys;
+	}
+	batch.count = 0;
+	if (count <= 0) {
+		return;
+	}
+	for (int k = 0; k < count; ++k) {
+		encode(batch.events[batch.count++], EV_KEY, keys[k], 1);
+	}
+	encode(batch.events[batch.count++], EV_SYN, SYN_REPORT, 0);
+	for (int k = count - 1; k >= 0; --k) {
+		encode(batch.events[batch.count++], EV_KEY, keys[k], 0);
+	}
+	encode(batch.events[batch.count++], EV_SYN, SYN_REPORT, 0);
+}
+
+bool Chord::parse(const std::string &spec, Chord &c) {
+	std::uint16_t keys[maxKeys];
+	int count = 0;
+	std::istringstream iss(spec);
+	std::string name;
+	while (std::getline(iss, name, '+')) {
+		int code = libevdev_event_code_from_name(EV_KEY, name.c_str());
+		if ((code < 0) || (count == maxKeys)) {
+			return false;
+		}
+		keys[count++] = code;
+	}
+	if (!count) {
+		return false;
+	}
+	c = Chord(keys, count);
+	return true;
+}
+
+std::string Chord::name() const {
+	std::string str;
+	for (int k = 0; k < size(); ++k) {
+		if (k) {
+			str += '+';
+		}
+		const char *n = libevdev_event_code_get_name(EV_KEY, key(k));
+		str += n ? n : std::to_string(key(k));
+	}
+	return str;
+}
+
+bool Chord::operator == (const Chord &c) const {
+	if (size() != c.size()) {
+		return false;
+	}
+	for (int k = 0; k < size(); ++k) {
+		if (key(k) != c.key(k)) {
+			return false;
+		}
+	}
+	return true;
+}
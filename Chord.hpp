@@ -0,0 +1,88 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef CHORD_HPP
+#define CHORD_HPP
+
+#include "EvdevOutput.hpp"
+#include <string>
+
+/**
+ * A key combination, like KEY_LEFTMETA with KEY_LEFT, sent in response to a
+ * gesture. The events that press the keys in order and then release them in
+ * reverse are encoded when the chord is made, so sending it is a single
+ * write of a ready batch.
+ * @author  Jeff Jackowski
+ */
+class Chord {
+public:
+	/**
+	 * The most keys in a chord; each key needs a press and a release, and the
+	 * presses and releases each need a SYN_REPORT, all in a single frame.
+	 */
+	static constexpr int maxKeys = (EvdevOutput::maxFrameEvents - 2) / 2;
+private:
+	/**
+	 * The encoded events, or no events for an empty chord.
+	 */
+	EvdevOutput::Frame batch;
+public:
+	/**
+	 * Makes an empty chord that sends nothing.
+	 */
+	Chord() {
+		batch.count = 0;
+	}
+	/**
+	 * Makes a chord from key codes.
+	 * @param keys   The keys in the order they are pressed.
+	 * @param count  The number of keys; no more than maxKeys are used.
+	 */
+	Chord(const std::uint16_t *keys, int count);
+	/**
+	 * Parses a chord given as key names joined by '+', like
+	 * "KEY_LEFTMETA+KEY_LEFT". The names are those in
+	 * linux/input-event-codes.h.
+	 * @return  False if a name is unknown or there are too many keys.
+	 */
+	static bool parse(const std::string &spec, Chord &c);
+	/**
+	 * True if the chord has no keys.
+	 */
+	bool empty() const {
+		return !batch.count;
+	}
+	/**
+	 * The number of keys.
+	 */
+	int size() const {
+		return batch.count ? (batch.count - 2) / 2 : 0;
+	}
+	/**
+	 * The key pressed at the given position.
+	 */
+	std::uint16_t key(int i) const {
+		return batch.events[i].code;
+	}
+	/**
+	 * The events to send.
+	 */
+	const EvdevOutput::Frame &frame() const {
+		return batch;
+	}
+	/**
+	 * The chord in the form read by parse(), or an empty string.
+	 */
+	std::string name() const;
+	bool operator == (const Chord &c) const;
+};
+
+#endif        //  #ifndef CHORD_HPP
@@ -0,0 +1,336 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "ControlServer.hpp"
+#include "AllocCount.hpp"
+#include "FlightRecorder.hpp"
+#include "Log.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * The longest accepted command line. Longer lines close the connection.
+ */
+static const std::size_t maxLine = 256;
+
+/**
+ * Names for buttons that may be used for taps.
+ */
+static const struct ButtonName {
+	const char *name;
+	std::uint16_t code;
+} buttonNames[] = {
+	{ "left", BTN_LEFT },
+	{ "right", BTN_RIGHT },
+	{ "middle", BTN_MIDDLE },
+	{ "side", BTN_SIDE },
+	{ "extra", BTN_EXTRA },
+	{ "forward", BTN_FORWARD },
+	{ "back", BTN_BACK }
+};
+
+static const char *buttonName(std::uint16_t code) {
+	for (const ButtonName &bn : buttonNames) {
+		if (bn.code == code) {
+			return bn.name;
+		}
+	}
+	return "unknown";
+}
+
+/**
+ * Parses a whole string as a non-negative integer.
+ */
+static bool parseCount(const std::string &str, int &val) {
+	char *end;
+	long l = std::strtol(str.c_str(), &end, 10);
+	if (str.empty() || *end || (l < 0) || (l > 0x7FFFFFFF)) {
+		return false;
+	}
+	val = (int)l;
+	return true;
+}
+
+static bool parseBool(const std::string &str, bool &val) {
+	if ((str == "1") || (str == "on") || (str == "true")) {
+		val = true;
+	} else if ((str == "0") || (str == "off") || (str == "false")) {
+		val = false;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+ControlServer::ControlServer(
+	Poller &p,
+	const DeviceManagerShared &dm,
+	const std::string &file
+) : poller(p), devman(dm), path(file) {
+	sockaddr_un addr = { };
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		BOOST_THROW_EXCEPTION(ControlSocketError() <<
+			boost::errinfo_errno(ENAMETOOLONG) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	std::strcpy(addr.sun_path, path.c_str());
+	lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (lfd < 0) {
+		BOOST_THROW_EXCEPTION(ControlSocketError() <<
+			boost::errinfo_errno(errno) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	// a socket left by an earlier run prevents bind(); any other file is
+	// kept, and causes bind() to fail
+	struct stat st;
+	if (!lstat(path.c_str(), &st) && S_ISSOCK(st.st_mode)) {
+		unlink(path.c_str());
+	}
+	// only the same user may connect
+	mode_t mask = umask(0177);
+	int result = bind(lfd, (const sockaddr*)&addr, sizeof(addr));
+	umask(mask);
+	if (result || listen(lfd, 4)) {
+		int err = errno;
+		close(lfd);
+		BOOST_THROW_EXCEPTION(ControlSocketError() <<
+			boost::errinfo_errno(err) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+}
+
+ControlServer::~ControlServer() {
+	for (const std::pair<const int, std::string> &client : clients) {
+		close(client.first);
+	}
+	close(lfd);
+	unlink(path.c_str());
+}
+
+void ControlServer::start() {
+	poller.add(shared_from_this(), lfd);
+}
+
+void ControlServer::accept() {
+	int fd;
+	while ((fd = accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		clients[fd];
+		poller.add(shared_from_this(), fd);
+	}
+}
+
+void ControlServer::hangup(int fd) {
+	poller.remove(fd);
+	clients.erase(fd);
+	close(fd);
+}
+
+void ControlServer::receive(int fd) {
+	std::string &buf = clients[fd];
+	char in[256];
+	ssize_t len;
+	while ((len = read(fd, in, sizeof(in))) > 0) {
+		buf.append(in, len);
+		std::string::size_type nl;
+		while ((nl = buf.find('\n')) != std::string::npos) {
+			std::string reply = command(buf.substr(0, nl));
+			buf.erase(0, nl + 1);
+			// a client that does not read its replies is dropped
+			if (
+				send(fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT)
+				!= (ssize_t)reply.size()
+			) {
+				hangup(fd);
+				return;
+			}
+		}
+		if (buf.size() > maxLine) {
+			hangup(fd);
+			return;
+		}
+	}
+	if (!len || (errno != EAGAIN)) {
+		hangup(fd);
+	}
+}
+
+std::string ControlServer::command(const std::string &line) {
+	std::istringstream iss(line);
+	std::string cmd, key, value, extra;
+	iss >> cmd >> key >> value >> extra;
+	MtTranslate::Config cfg(devman->config());
+	if (cmd == "get") {
+		std::ostringstream oss;
+		oss << "device " << devman->device() <<
+		"\nmovethres " << cfg.moveDist <<
+		"\nscrolldist " << cfg.scrollDist <<
+		"\nkinetic " << cfg.kinetic <<
+		"\nmaxmajor " << cfg.maxMajor <<
+		"\nmaxminor " << cfg.maxMinor <<
+		"\nminpressure " << cfg.minPressure <<
+		"\npinchdist " << cfg.pinchDist <<
+		"\ntwist " << cfg.twist <<
+		"\nholdtime " << cfg.holdTime <<
+		"\nholdbutton " << buttonName(cfg.holdButton) <<
+		"\ntappercentile " << cfg.tapPercentile <<
+		"\ntapmin " << cfg.tapMin <<
+		"\ntapmax " << cfg.tapMax <<
+		"\nflickspeed " << cfg.flickSpeed <<
+		"\nregions " << cfg.regions.size() <<
+		"\ntap1 " << buttonName(cfg.buttons[0]) <<
+		"\ntap2 " << buttonName(cfg.buttons[1]) <<
+		"\ntap3 " << buttonName(cfg.buttons[2]) <<
+		"\npaused " << cfg.paused <<
+		"\nloglevel " << Log::name(Log::level()) <<
+		"\nlogdropped " << Log::dropped() <<
+		"\nhotallocs " << AllocCount::hot() <<
+		"\nuringwriteerrors " << poller.writeErrors() << '\n';
+		const MtTranslate *mt = devman->translation();
+		if (mt) {
+			const MtTranslate::RejectStats &rs = mt->rejectStats();
+			EvdevOutput::PipelineStats ps = mt->output().pipelineStats();
+			oss << "operation " << mt->operationName() <<
+			"\ncontacts " << mt->contacts() <<
+			"\ntapwindow " << mt->tapTime().count() <<
+			"\nrejectsize " << rs.size <<
+			"\nrejectpressure " << rs.pressure <<
+			"\nrejectpalm " << rs.palm <<
+			"\nskipped " << mt->skippedFrames() <<
+			"\nframes " << ps.frames <<
+			"\ndropped " << ps.dropped <<
+			"\nfolded " << ps.folded <<
+			"\nwriteerrors " << ps.writeErrors << '\n';
+		}
+		return oss.str() + "ok\n";
+	} else if ((cmd == "set") && !value.empty() && extra.empty()) {
+		std::string err = set(key, value);
+		if (!err.empty()) {
+			return "error: " + err + '\n';
+		}
+		return "ok\n";
+	} else if (((cmd == "pause") || (cmd == "resume")) && key.empty()) {
+		cfg.paused = cmd == "pause";
+		devman->configure(cfg);
+		return "ok\n";
+	} else if ((cmd == "dump") && key.empty()) {
+		FlightRecorder *fr = FlightRecorder::active();
+		if (!fr) {
+			return "error: not recording\n";
+		}
+		if (!fr->dump()) {
+			return "error: cannot write " + fr->file() + '\n';
+		}
+		return "file " + fr->file() + "\nok\n";
+	} else if (cmd.empty()) {
+		return "error: no command\n";
+	}
+	return "error: unknown command; use get, set KEY VALUE, pause, resume,"
+		" or dump\n";
+}
+
+std::string ControlServer::set(const std::string &key, const std::string &value) {
+	MtTranslate::Config cfg(devman->config());
+	int *count = nullptr;
+	bool *flag = nullptr;
+	int minimum = 0;
+	int maximum = std::numeric_limits<int>::max();
+	if (key == "movethres") {
+		count = &cfg.moveDist;
+	} else if (key == "scrolldist") {
+		count = &cfg.scrollDist;
+		minimum = 1;
+	} else if (key == "maxmajor") {
+		count = &cfg.maxMajor;
+	} else if (key == "maxminor") {
+		count = &cfg.maxMinor;
+	} else if (key == "minpressure") {
+		count = &cfg.minPressure;
+	} else if (key == "pinchdist") {
+		count = &cfg.pinchDist;
+	} else if (key == "holdtime") {
+		count = &cfg.holdTime;
+	} else if (key == "tappercentile") {
+		count = &cfg.tapPercentile;
+		maximum = 100;
+	} else if (key == "tapmin") {
+		count = &cfg.tapMin;
+	} else if (key == "tapmax") {
+		count = &cfg.tapMax;
+		minimum = 1;
+	} else if (key == "flickspeed") {
+		count = &cfg.flickSpeed;
+	} else if (key == "twist") {
+		flag = &cfg.twist;
+	} else if (key == "kinetic") {
+		flag = &cfg.kinetic;
+	} else if (key == "paused") {
+		flag = &cfg.paused;
+	} else if (key == "loglevel") {
+		Log::Level lvl;
+		if (!Log::parse(value, lvl)) {
+			return "unknown log level " + value;
+		}
+		Log::level(lvl);
+		return std::string();
+	} else if ((key == "holdbutton") || (
+		(key.size() == 4) && !key.compare(0, 3, "tap") &&
+		(key[3] >= '1') && (key[3] <= '3')
+	)) {
+		for (const ButtonName &bn : buttonNames) {
+			if (value == bn.name) {
+				if (key == "holdbutton") {
+					cfg.holdButton = bn.code;
+				} else {
+					cfg.buttons[key[3] - '1'] = bn.code;
+				}
+				devman->configure(cfg);
+				return std::string();
+			}
+		}
+		return "unknown button " + value;
+	} else {
+		return "unknown setting " + key;
+	}
+	if (count) {
+		if (
+			!parseCount(value, *count) || (*count < minimum) ||
+			(*count > maximum)
+		) {
+			return "invalid number " + value;
+		}
+		if (cfg.tapMax < cfg.tapMin) {
+			return "the longest tap time cannot be less than the shortest";
+		}
+	} else if (!parseBool(value, *flag)) {
+		return "invalid boolean " + value;
+	}
+	devman->configure(cfg);
+	return std::string();
+}
+
+void ControlServer::respond(int fd) {
+	if (fd == lfd) {
+		accept();
+	} else {
+		receive(fd);
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef CONTROLSERVER_HPP
+#define CONTROLSERVER_HPP
+
+#include "DeviceManager.hpp"
+#include <map>
+
+struct ControlError : virtual std::exception, virtual boost::exception { };
+struct ControlSocketError : ControlError { };
+
+/**
+ * Accepts commands on a Unix domain socket to query and change the
+ * translator's settings while running. Commands are lines of text; each is
+ * answered with zero or more lines of data followed by a line with either
+ * "ok" or "error: " and a description. The commands are:
+ * @li @c get  Reports the settings and the current state.
+ * @li @c set @a key @a value  Changes a setting. The keys match the names
+ *     reported by @c get.
+ * @li @c pause  Ignores touch input until resumed.
+ * @li @c resume  Undoes @c pause.
+ * @li @c dump  Writes the FlightRecorder's records to its file.
+ *
+ * All work is done in response to the Poller on the same thread that handles
+ * touch input, so no locking is needed. Changes that arrive while a frame of
+ * touch input is partly received take effect when the frame is complete.
+ * @author  Jeff Jackowski
+ */
+class ControlServer :
+	boost::noncopyable,
+	public PollResponse,
+	public std::enable_shared_from_this<ControlServer>
+{
+	/**
+	 * The poller used for the socket and connections.
+	 */
+	Poller &poller;
+	/**
+	 * The settings changed by commands are kept here.
+	 */
+	DeviceManagerShared devman;
+	/**
+	 * The socket's file name.
+	 */
+	std::string path;
+	/**
+	 * Partially received command lines keyed by the connection's file
+	 * descriptor.
+	 */
+	std::map<int, std::string> clients;
+	/**
+	 * The listening socket.
+	 */
+	int lfd;
+	/**
+	 * Accepts waiting connections.
+	 */
+	void accept();
+	/**
+	 * Reads and runs commands from a connection.
+	 */
+	void receive(int fd);
+	/**
+	 * Closes a connection.
+	 */
+	void hangup(int fd);
+	/**
+	 * Runs a command.
+	 * @return  The response text.
+	 */
+	std::string command(const std::string &line);
+	/**
+	 * Changes a setting.
+	 * @return  An empty string on success, or a description of the problem.
+	 */
+	std::string set(const std::string &key, const std::string &value);
+public:
+	/**
+	 * Makes the listening socket. An existing socket file with the same name
+	 * is replaced. The socket is only usable by the same user.
+	 * @param p     The poller used for the socket and connections.
+	 * @param dm    Controls the translator.
+	 * @param file  The socket's file name.
+	 * @throw ControlSocketError  The socket could not be made.
+	 */
+	ControlServer(Poller &p, const DeviceManagerShared &dm, const std::string &file);
+	/**
+	 * Closes all connections and removes the socket file.
+	 */
+	~ControlServer();
+	/**
+	 * Starts accepting connections.
+	 */
+	void start();
+	/**
+	 * Handles new connections and incoming commands.
+	 */
+	virtual void respond(int fd);
+};
+
+typedef std::shared_ptr<ControlServer>  ControlServerShared;
+
+#endif        //  #ifndef CONTROLSERVER_HPP
@@ -0,0 +1,101 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Deadlines.hpp"
+
+Deadlines::Deadlines() :
+cursor(tickOf(std::chrono::steady_clock::now())), count(0) {
+	for (Entry &e : entries) {
+		e.tick = 0;
+		e.next = -1;
+		e.armed = false;
+	}
+	for (std::int8_t &h : heads) {
+		h = -1;
+	}
+}
+
+void Deadlines::unlink(int id) {
+	Entry &e = entries[id];
+	std::int8_t *link = &heads[e.tick % buckets];
+	while (*link != id) {
+		link = &entries[*link].next;
+	}
+	*link = e.next;
+	e.next = -1;
+	e.armed = false;
+	--count;
+}
+
+void Deadlines::schedule(int id, timepoint when) {
+	if (entries[id].armed) {
+		unlink(id);
+	}
+	Entry &e = entries[id];
+	e.when = when;
+	// a deadline already past goes in the next bucket to be expired
+	e.tick = tickOf(when);
+	if (e.tick < cursor) {
+		e.tick = cursor;
+	}
+	std::int8_t &head = heads[e.tick % buckets];
+	e.next = head;
+	head = id;
+	e.armed = true;
+	++count;
+}
+
+void Deadlines::cancel(int id) {
+	if (entries[id].armed) {
+		unlink(id);
+	}
+}
+
+Deadlines::timepoint Deadlines::next() const {
+	timepoint soonest = timepoint::max();
+	if (!count) {
+		return soonest;
+	}
+	// the first bucket holding a deadline for its current turn has the
+	// earliest deadline
+	for (std::int64_t t = cursor; t < cursor + buckets; ++t) {
+		for (int id = heads[t % buckets]; id >= 0; id = entries[id].next) {
+			if ((entries[id].tick == t) && (entries[id].when < soonest)) {
+				soonest = entries[id].when;
+			}
+		}
+		if (soonest != timepoint::max()) {
+			return soonest;
+		}
+	}
+	// all deadlines are more than a turn away
+	for (const Entry &e : entries) {
+		if (e.armed && (e.when < soonest)) {
+			soonest = e.when;
+		}
+	}
+	return soonest;
+}
+
+std::chrono::milliseconds Deadlines::timeout(timepoint now) const {
+	if (!count) {
+		return std::chrono::milliseconds(-1);
+	}
+	timepoint soonest = next();
+	if (soonest <= now) {
+		return std::chrono::milliseconds(0);
+	}
+	// round up so the wait does not end just before the deadline
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		soonest - now + std::chrono::milliseconds(1) -
+		std::chrono::steady_clock::duration(1)
+	);
+}
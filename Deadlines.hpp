@@ -0,0 +1,152 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef DEADLINES_HPP
+#define DEADLINES_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Keeps the times when pending gestures must be resolved if no input
+ * arrives first. Each deadline is identified by a small number chosen by
+ * the user; scheduling an identifier that is already pending moves it.
+ *
+ * The deadlines are kept in a hashed timer wheel: a ring of buckets that
+ * each cover a short span of time, with the deadlines in a bucket kept in a
+ * linked list threaded through a fixed array. Scheduling and cancelling take
+ * constant time, and expire() only looks at the buckets for the time that
+ * has passed. Nothing is allocated after construction.
+ * @author  Jeff Jackowski
+ */
+class Deadlines {
+public:
+	typedef std::chrono::steady_clock::time_point  timepoint;
+	/**
+	 * The number of identifiers, which is the most deadlines that can be
+	 * pending at once.
+	 */
+	static constexpr int maxIds = 8;
+	/**
+	 * The number of buckets in the wheel.
+	 */
+	static constexpr int buckets = 64;
+	/**
+	 * The span of time covered by each bucket. Deadlines further away than
+	 * one turn of the wheel stay in their bucket for more turns.
+	 */
+	static constexpr std::chrono::milliseconds tick =
+		std::chrono::milliseconds(4);
+private:
+	struct Entry {
+		/**
+		 * The deadline.
+		 */
+		timepoint when;
+		/**
+		 * The tick of the bucket holding the entry.
+		 */
+		std::int64_t tick;
+		/**
+		 * The next identifier in the same bucket, or -1.
+		 */
+		std::int8_t next;
+		/**
+		 * True if the deadline is pending.
+		 */
+		bool armed;
+	};
+	Entry entries[maxIds];
+	/**
+	 * The first identifier in each bucket's list, or -1.
+	 */
+	std::int8_t heads[buckets];
+	/**
+	 * The tick up to which deadlines have been expired.
+	 */
+	std::int64_t cursor;
+	/**
+	 * The number of pending deadlines.
+	 */
+	int count;
+	static std::int64_t tickOf(timepoint t) {
+		return t.time_since_epoch() / tick;
+	}
+	/**
+	 * Removes a pending deadline from its bucket.
+	 */
+	void unlink(int id);
+public:
+	Deadlines();
+	/**
+	 * Sets the deadline for an identifier, replacing any pending deadline
+	 * it has.
+	 * @param id    The identifier, from zero to maxIds - 1.
+	 * @param when  The deadline. A time already past expires on the next
+	 *              call to expire().
+	 */
+	void schedule(int id, timepoint when);
+	/**
+	 * Removes the identifier's deadline, if pending.
+	 */
+	void cancel(int id);
+	/**
+	 * True if the identifier has a deadline.
+	 */
+	bool pending(int id) const {
+		return entries[id].armed;
+	}
+	/**
+	 * True if no deadlines are pending.
+	 */
+	bool empty() const {
+		return !count;
+	}
+	/**
+	 * The earliest pending deadline, or timepoint::max() if there are none.
+	 */
+	timepoint next() const;
+	/**
+	 * The time from @a now until the earliest deadline, rounded up to whole
+	 * milliseconds for use as a poll timeout. Returns -1 if no deadlines are
+	 * pending, which makes Poller::wait() wait indefinitely.
+	 */
+	std::chrono::milliseconds timeout(timepoint now) const;
+	/**
+	 * Removes each deadline that is at or before @a now and calls the given
+	 * function with its identifier, earliest bucket first. The function may
+	 * schedule deadlines.
+	 */
+	template <class F>
+	void expire(timepoint now, F f) {
+		if (!count) {
+			cursor = tickOf(now);
+			return;
+		}
+		std::int64_t last = tickOf(now);
+		// no more than one turn needs to be visited
+		std::int64_t t = last - cursor >= buckets ? last - buckets + 1 : cursor;
+		for (; t <= last; ++t) {
+			int id = heads[t % buckets];
+			while (id >= 0) {
+				int n = entries[id].next;
+				if (entries[id].when <= now) {
+					unlink(id);
+					f(id);
+				}
+				id = n;
+			}
+		}
+		cursor = last;
+	}
+};
+
+#endif        //  #ifndef DEADLINES_HPP
@@ -0,0 +1,194 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "DeviceManager.hpp"
+#include "AllocCount.hpp"
+#include "Discovery.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+ * The directory with the input device files.
+ */
+static const char inputDir[] = "/dev/input";
+
+DeviceManager::DeviceManager(
+	Poller &p,
+	const TranslatorFactory &f,
+	const std::vector<std::string> &paths,
+	const MtTranslate::Config &c
+) : poller(p), factory(f), allowed(paths), cfg(c), infd(-1) { }
+
+DeviceManager::~DeviceManager() {
+	detach();
+	if (infd >= 0) {
+		close(infd);
+	}
+}
+
+EvdevShared DeviceManager::openTouchscreen(const std::string &dev, bool verbose) {
+	EvdevShared evin;
+	try {
+		evin = std::make_shared<Evdev>(dev);
+	} catch (EvdevError &) {
+		if (verbose) {
+			std::cerr << "Failed to open " << dev << '.' << std::endl;
+		}
+		return EvdevShared();
+	}
+	// check for touch input
+	if (!evin->hasEventType(EV_ABS) || (evin->numSlots() < 0)) {
+		if (verbose) {
+			std::cerr << "Device " << dev << ", " << evin->name() <<
+			", is not a touch screen." << std::endl;
+		}
+		return EvdevShared();
+	}
+	std::cout << "Using device " << dev << ", " << evin->name() << '.'
+	<< std::endl;
+	if (!evin->grab()) {
+		std::cerr << "Cannot gain exclusive access." << std::endl;
+	}
+	return evin;
+}
+
+bool DeviceManager::attach(const std::string &dev, bool verbose) {
+	EvdevShared evin = openTouchscreen(dev, verbose);
+	if (!evin) {
+		return false;
+	}
+	use(dev, std::move(evin));
+	return true;
+}
+
+void DeviceManager::adopt(const std::string &dev, const EvdevShared &evin) {
+	std::cout << "Using device " << dev << ", " << evin->name() << '.'
+	<< std::endl;
+	use(dev, EvdevShared(evin));
+}
+
+void DeviceManager::use(const std::string &dev, EvdevShared &&evin) {
+	evin->usePoller(poller);
+	try {
+		translator = factory(evin);
+		translator->configure(cfg);
+	} catch (...) {
+		evin->removeFromPoller();
+		throw;
+	}
+	evin->onLost(std::bind(&DeviceManager::lost, this));
+	evdev = std::move(evin);
+	path = dev;
+}
+
+void DeviceManager::detach() {
+	if (!translator) {
+		return;
+	}
+	// destroy the translator first; it uses evdev
+	translator.reset();
+	evdev->removeFromPoller();
+	evdev.reset();
+	path.clear();
+}
+
+void DeviceManager::lost() {
+	std::cerr << "Touchscreen " << path << " is no longer available." <<
+	std::endl;
+	std::string old(path);
+	detach();
+	attachFirst(discoverTouchscreens(allowed), old);
+}
+
+bool DeviceManager::attachFirst(
+	const std::vector<std::string> &candidates,
+	const std::string &exclude
+) {
+	for (const std::string &dev : candidates) {
+		if ((dev != exclude) && attach(dev, true)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void DeviceManager::watch() {
+	if (infd >= 0) {
+		return;
+	}
+	infd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (infd < 0) {
+		BOOST_THROW_EXCEPTION(DeviceManagerWatchError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+	// attribute changes are included because udev may set permissions after
+	// the device file is made
+	if (inotify_add_watch(infd, inputDir, IN_CREATE | IN_ATTRIB | IN_DELETE) < 0) {
+		int err = errno;
+		close(infd);
+		infd = -1;
+		BOOST_THROW_EXCEPTION(DeviceManagerWatchError() <<
+			boost::errinfo_errno(err)
+		);
+	}
+	poller.add(shared_from_this(), infd);
+}
+
+void DeviceManager::configure(const MtTranslate::Config &c) {
+	cfg = c;
+	if (translator) {
+		translator->configure(cfg);
+	}
+}
+
+void DeviceManager::timeoutHandle() {
+	if (translator) {
+		AllocCount::HotPath hp;
+		translator->timeoutHandle();
+	}
+}
+
+void DeviceManager::respond(int) {
+	alignas(inotify_event) char buf[4096];
+	ssize_t len;
+	while ((len = read(infd, buf, sizeof(buf))) > 0) {
+		for (char *ptr = buf; ptr < buf + len;) {
+			const inotify_event *ie = (const inotify_event*)ptr;
+			ptr += sizeof(inotify_event) + ie->len;
+			// only event devices are of interest
+			if (!ie->len || std::strncmp(ie->name, "event", 5)) {
+				continue;
+			}
+			std::string dev = std::string(inputDir) + '/' + ie->name;
+			if (ie->mask & IN_DELETE) {
+				if (dev == path) {
+					lost();
+				}
+			} else if (
+				!translator &&
+				(
+					allowed.empty() ||
+					(std::find(allowed.begin(), allowed.end(), dev) !=
+					allowed.end())
+				) &&
+				(inspectDevice(dev) != DeviceKind::Other)
+			) {
+				// the device may not be ready; a later event will try again
+				attach(dev, false);
+			}
+		}
+	}
+}
@@ -0,0 +1,198 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef DEVICEMANAGER_HPP
+#define DEVICEMANAGER_HPP
+
+#include "MtTranslate.hpp"
+
+struct DeviceManagerError : virtual std::exception, virtual boost::exception { };
+struct DeviceManagerWatchError : DeviceManagerError { };
+
+/**
+ * Finds a touchscreen, attaches a translator to it, and optionally follows
+ * input devices as they are added and removed. One touchscreen is used at a
+ * time. When it goes away, the translator is destroyed, which releases any
+ * held buttons and removes the output device, and another touchscreen is
+ * used if one is available.
+ *
+ * Added and removed devices are found through inotify on /dev/input, so
+ * nothing is done while no devices change.
+ * @author  Jeff Jackowski
+ */
+class DeviceManager :
+	boost::noncopyable,
+	public PollResponse,
+	public std::enable_shared_from_this<DeviceManager>
+{
+public:
+	/**
+	 * Makes a configured translator for a touchscreen.
+	 */
+	typedef std::function<std::unique_ptr<MtTranslate>(const EvdevShared &)>
+		TranslatorFactory;
+private:
+	/**
+	 * The poller used by the touchscreen and translator.
+	 */
+	Poller &poller;
+	/**
+	 * Makes new translators.
+	 */
+	TranslatorFactory factory;
+	/**
+	 * The device files that may be used. If empty, any input device may be
+	 * used.
+	 */
+	std::vector<std::string> allowed;
+	/**
+	 * The device file of the touchscreen in use.
+	 */
+	std::string path;
+	/**
+	 * The touchscreen in use.
+	 */
+	EvdevShared evdev;
+	/**
+	 * The translator for the touchscreen in use.
+	 */
+	std::unique_ptr<MtTranslate> translator;
+	/**
+	 * The translator settings. Kept here so that changes made while running
+	 * also apply to touchscreens attached later.
+	 */
+	MtTranslate::Config cfg;
+	/**
+	 * The inotify file descriptor, or -1 if not watching for devices.
+	 */
+	int infd;
+	/**
+	 * Attempts to use the given device.
+	 * @param dev      The device file.
+	 * @param verbose  True to report why a device cannot be used.
+	 * @return         True if the device is now in use.
+	 */
+	bool attach(const std::string &dev, bool verbose);
+	/**
+	 * Makes a translator for an open touchscreen and starts using it.
+	 */
+	void use(const std::string &dev, EvdevShared &&evin);
+	/**
+	 * Stops using the current touchscreen.
+	 */
+	void detach();
+	/**
+	 * Called when the touchscreen in use stops working.
+	 */
+	void lost();
+public:
+	/**
+	 * @param p      The poller used for input.
+	 * @param f      Makes translators for touchscreens.
+	 * @param paths  The device files that may be used, or empty to allow
+	 *               any input device.
+	 * @param c      The initial translator settings. They replace the
+	 *               settings of translators made by @a f.
+	 */
+	DeviceManager(
+		Poller &p,
+		const TranslatorFactory &f,
+		const std::vector<std::string> &paths,
+		const MtTranslate::Config &c = MtTranslate::Config()
+	);
+	~DeviceManager();
+	/**
+	 * Opens a device and checks that it is a touchscreen, reporting problems
+	 * to stderr.
+	 * @return  The touchscreen, or an empty pointer if the device cannot be
+	 *          used.
+	 */
+	static EvdevShared openTouchscreen(const std::string &dev, bool verbose);
+	/**
+	 * Uses the first of the given devices that is a working touchscreen.
+	 * @param candidates  Device files in order of preference.
+	 * @param exclude     A device to skip.
+	 * @return            True if a touchscreen is in use.
+	 */
+	bool attachFirst(
+		const std::vector<std::string> &candidates,
+		const std::string &exclude = std::string()
+	);
+	/**
+	 * Uses a touchscreen that is already open and grabbed, such as one
+	 * handed over by another process.
+	 * @param dev   The device file, for reporting.
+	 * @param evin  The touchscreen.
+	 */
+	void adopt(const std::string &dev, const EvdevShared &evin);
+	/**
+	 * Starts following devices as they are added and removed.
+	 * @throw DeviceManagerWatchError  inotify could not be used.
+	 */
+	void watch();
+	/**
+	 * True if a touchscreen is in use.
+	 */
+	bool attached() const {
+		return (bool)translator;
+	}
+	/**
+	 * The device file of the touchscreen in use, or an empty string.
+	 */
+	const std::string &device() const {
+		return path;
+	}
+	/**
+	 * The translator in use, or nullptr if no touchscreen is in use.
+	 */
+	const MtTranslate *translation() const {
+		return translator.get();
+	}
+	MtTranslate *translation() {
+		return translator.get();
+	}
+	/**
+	 * The touchscreen in use, if any.
+	 */
+	const EvdevShared &touchscreen() const {
+		return evdev;
+	}
+	/**
+	 * Changes the translator settings. See MtTranslate::configure().
+	 */
+	void configure(const MtTranslate::Config &c);
+	/**
+	 * The translator settings.
+	 */
+	const MtTranslate::Config &config() const {
+		return cfg;
+	}
+	/**
+	 * The time until timeoutHandle() next needs to be called, or -1 if
+	 * nothing is pending. See MtTranslate::timeout().
+	 */
+	std::chrono::milliseconds timeout() const {
+		return translator ? translator->timeout() :
+			std::chrono::milliseconds(-1);
+	}
+	/**
+	 * Passes the poll timeout on to the translator.
+	 */
+	void timeoutHandle();
+	/**
+	 * Handles inotify events.
+	 */
+	virtual void respond(int fd);
+};
+
+typedef std::shared_ptr<DeviceManager>  DeviceManagerShared;
+
+#endif        //  #ifndef DEVICEMANAGER_HPP
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Discovery.hpp"
+#include <linux/input.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <climits>
+#include <dirent.h>
+
+/**
+ * A capability bitmap as shown in sysfs: hexadecimal words separated by
+ * spaces with the most significant word first, omitting leading zero words.
+ * The words are the size of the kernel's long, which may differ from user
+ * space's. This is only used for bitmaps of at most 64 bits, so more than
+ * one word means the words are 32 bits.
+ */
+class SysfsBitmap {
+	std::vector<unsigned long long> words;
+	int bitsPerWord;
+public:
+	/**
+	 * Reads a bitmap file.
+	 * @return  False if the file could not be read.
+	 */
+	bool load(const std::string &path) {
+		std::ifstream file(path);
+		std::string line;
+		if (!file || !std::getline(file, line)) {
+			return false;
+		}
+		std::istringstream iss(line);
+		std::string word;
+		words.clear();
+		while (iss >> word) {
+			words.push_back(std::strtoull(word.c_str(), nullptr, 16));
+		}
+		bitsPerWord = (words.size() > 1) ? 32 : 64;
+		// least significant word first
+		std::reverse(words.begin(), words.end());
+		return !words.empty();
+	}
+	bool test(unsigned int bit) const {
+		unsigned int w = bit / bitsPerWord;
+		return (w < words.size()) && ((words[w] >> (bit % bitsPerWord)) & 1);
+	}
+};
+
+/**
+ * Finds the name used in sysfs, like event0, for a device file.
+ */
+static std::string sysName(const std::string &path) {
+	char real[PATH_MAX];
+	std::string name(realpath(path.c_str(), real) ? real : path);
+	std::string::size_type slash = name.rfind('/');
+	if (slash != std::string::npos) {
+		name.erase(0, slash + 1);
+	}
+	return name;
+}
+
+DeviceKind inspectDevice(const std::string &path, const std::string &sysroot) {
+	std::string dir = sysroot + '/' + sysName(path) + "/device/";
+	SysfsBitmap ev, abs;
+	if (
+		!ev.load(dir + "capabilities/ev") ||
+		!abs.load(dir + "capabilities/abs")
+	) {
+		return DeviceKind::Unknown;
+	}
+	if (
+		ev.test(EV_ABS) &&
+		abs.test(ABS_MT_SLOT) &&
+		abs.test(ABS_MT_POSITION_X) &&
+		abs.test(ABS_MT_POSITION_Y)
+	) {
+		return DeviceKind::Touchscreen;
+	}
+	return DeviceKind::Other;
+}
+
+/**
+ * True if the device reports input that is directly on a display.
+ */
+static bool isDirect(const std::string &path, const std::string &sysroot) {
+	SysfsBitmap props;
+	return props.load(sysroot + '/' + sysName(path) + "/device/properties") &&
+		props.test(INPUT_PROP_DIRECT);
+}
+
+/**
+ * Lists the event devices in sysfs in numerical order.
+ */
+static std::vector<std::string> eventDevices(const std::string &sysroot) {
+	std::vector<std::pair<int, std::string> > found;
+	DIR *dir = opendir(sysroot.c_str());
+	if (dir) {
+		while (dirent *de = readdir(dir)) {
+			int num;
+			char extra;
+			if (std::sscanf(de->d_name, "event%d%c", &num, &extra) == 1) {
+				found.emplace_back(num, std::string("/dev/input/") + de->d_name);
+			}
+		}
+		closedir(dir);
+	}
+	std::sort(found.begin(), found.end());
+	std::vector<std::string> paths;
+	paths.reserve(found.size());
+	for (auto &f : found) {
+		paths.push_back(std::move(f.second));
+	}
+	return paths;
+}
+
+std::vector<std::string> discoverTouchscreens(
+	const std::vector<std::string> &paths,
+	const std::string &sysroot
+) {
+	std::vector<std::string> direct, indirect, unknown;
+	for (const std::string &path :
+		paths.empty() ? eventDevices(sysroot) : paths
+	) {
+		switch (inspectDevice(path, sysroot)) {
+			case DeviceKind::Touchscreen:
+				if (isDirect(path, sysroot)) {
+					direct.push_back(path);
+				} else {
+					indirect.push_back(path);
+				}
+				break;
+			case DeviceKind::Unknown:
+				unknown.push_back(path);
+				break;
+			default:
+				break;
+		}
+	}
+	direct.insert(direct.end(), indirect.begin(), indirect.end());
+	direct.insert(direct.end(), unknown.begin(), unknown.end());
+	return direct;
+}
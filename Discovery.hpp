@@ -0,0 +1,65 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef DISCOVERY_HPP
+#define DISCOVERY_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * The result of inspecting an input device through sysfs.
+ */
+enum class DeviceKind {
+	/**
+	 * Reports multi-touch protocol B contacts.
+	 */
+	Touchscreen,
+	/**
+	 * Definitely not a protocol B touchscreen.
+	 */
+	Other,
+	/**
+	 * The sysfs data could not be read; the device must be opened to find
+	 * out what it is.
+	 */
+	Unknown
+};
+
+/**
+ * Uses the capability bitmaps in sysfs to check if an input device is a
+ * multi-touch protocol B touchscreen without opening the device.
+ * @param path     The device file, like /dev/input/event0. Symbolic links,
+ *                 such as those under /dev/input/by-id, are followed.
+ * @param sysroot  The sysfs directory with the input class devices.
+ */
+DeviceKind inspectDevice(
+	const std::string &path,
+	const std::string &sysroot = "/sys/class/input"
+);
+
+/**
+ * Finds likely touchscreens among input devices without opening them.
+ * Devices that sysfs shows to be touchscreens come first, with those
+ * reporting direct input (a screen rather than a touchpad) ahead of the
+ * others. Devices that could not be inspected follow so that they may be
+ * checked by opening them. Devices that are definitely not touchscreens are
+ * omitted.
+ * @param paths    The device files to consider. If empty, all event devices
+ *                 listed in sysfs are considered.
+ * @param sysroot  The sysfs directory with the input class devices.
+ */
+std::vector<std::string> discoverTouchscreens(
+	const std::vector<std::string> &paths,
+	const std::string &sysroot = "/sys/class/input"
+);
+
+#endif        //  #ifndef DISCOVERY_HPP
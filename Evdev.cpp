@@ -10,6 +10,10 @@
  * Copyright (C) 2018  Jeff Jackowski
  */
 #include "Evdev.hpp"
+#include "AllocCount.hpp"
+#include "FlightRecorder.hpp"
+#include "Log.hpp"
+#include "Trace.hpp"
 #include <boost/exception/errinfo_file_name.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 
@@ -17,6 +21,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/ioctl.h>
+#include <ctime>
+#include <algorithm>
 
 const char *EventTypeCode::typeName() const {
 	return libevdev_event_type_get_name(type);
@@ -28,7 +35,10 @@ const char *EventTypeCode::codeName() const {
 
 //Evdev::Evdev() : dev(nullptr), fd(-1) { }
 
-Evdev::Evdev(const std::string &path) {
+Evdev::Evdev(libevdev *device) :
+poller(nullptr), dev(device), fd(-1), dropped(false), evtime(0) { }
+
+Evdev::Evdev(const std::string &path) : poller(nullptr), dropped(false), evtime(0) {
 	fd = open(path.c_str(), O_RDONLY);
 	if (fd < 0) {
 		BOOST_THROW_EXCEPTION(EvdevFileOpenError() <<
@@ -45,9 +55,24 @@ Evdev::Evdev(const std::string &path) {
 			boost::errinfo_file_name(path)
 		);
 	}
+	// match the clock used by std::chrono::steady_clock
+	libevdev_set_clock_id(dev, CLOCK_MONOTONIC);
 }
 
-Evdev::Evdev(Evdev &&e) : dev(e.dev), fd(e.fd) {
+Evdev::Evdev(int descriptor) :
+poller(nullptr), fd(descriptor), dropped(false), evtime(0) {
+	int result = libevdev_new_from_fd(fd, &dev);
+	if (result < 0) {
+		close(fd);
+		BOOST_THROW_EXCEPTION(EvdevInitError() <<
+			boost::errinfo_errno(-result)
+		);
+	}
+	libevdev_set_clock_id(dev, CLOCK_MONOTONIC);
+}
+
+Evdev::Evdev(Evdev &&e) :
+poller(nullptr), dev(e.dev), fd(e.fd), dropped(false), evtime(0) {
 	e.dev = nullptr;
 	e.fd = -1;
 }
@@ -72,20 +97,148 @@ Evdev &Evdev::operator=(Evdev &&old) {
 void Evdev::respond(int) {
 	input_event ie;
 	int result;
-	do {
-		result = libevdev_next_event(
-			dev,
-			LIBEVDEV_READ_FLAG_NORMAL | LIBEVDEV_READ_FLAG_BLOCKING,
-			&ie
-		);
-		if (result == LIBEVDEV_READ_STATUS_SUCCESS) {
-			EventTypeCode etc(ie.type, ie.code);
-			InputMap::const_iterator iter = receivers.find(etc);
-			if (iter != receivers.end()) {
-				iter->second(etc, ie.value);
+	{ // the input path; lost() below may allocate
+		AllocCount::HotPath hp;
+		do {
+			result = libevdev_next_event(
+				dev,
+				LIBEVDEV_READ_FLAG_NORMAL | LIBEVDEV_READ_FLAG_BLOCKING,
+				&ie
+			);
+			if (result == LIBEVDEV_READ_STATUS_SUCCESS) {
+				dispatch(ie);
+			}
+		} while ((result >= 0) && (libevdev_has_event_pending(dev) > 0));
+	}
+	if (result == -ENODEV) {
+		// unplugged; stop the poller from reporting the error repeatedly
+		removeFromPoller();
+		if (lost) {
+			lost();
+		}
+	}
+}
+
+void Evdev::received(int, const void *data, int size) {
+	if (size <= 0) {
+		// the poller no longer reads the device
+		removeFromPoller();
+		if (lost) {
+			lost();
+		}
+		return;
+	}
+	AllocCount::HotPath hp;
+	const input_event *ie = (const input_event*)data;
+	const input_event *end = ie + size / sizeof(input_event);
+	for (; ie < end; ++ie) {
+		if (ie->type == EV_SYN) {
+			if (ie->code == SYN_DROPPED) {
+				// discard the rest of the frame, then send the current state
+				dropped = true;
+				continue;
+			}
+			if (dropped && (ie->code == SYN_REPORT)) {
+				dropped = false;
+				resync();
+				continue;
+			}
+		}
+		if (!dropped) {
+			dispatch(*ie);
+		}
+	}
+}
+
+void Evdev::resync() {
+	// as many slots as the translators can track
+	constexpr int maxSlots = 64;
+	input_event ie;
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ie.input_event_sec = ts.tv_sec;
+	ie.input_event_usec = ts.tv_nsec / 1000;
+	// the slot values of each multi-touch axis with a receiver
+	struct {
+		std::uint32_t code;
+		std::int32_t values[maxSlots];
+	} mt[ABS_MT_TOOL_Y - ABS_MT_SLOT];
+	int axes = 0;
+	int slots = std::min(numSlots(), maxSlots);
+	for (const InputMap::value_type &r : receivers) {
+		if (r.first.type == EV_KEY) {
+			const int bits = 8 * sizeof(unsigned long);
+			unsigned long keys[KEY_MAX / bits + 1];
+			if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+				ie.type = EV_KEY;
+				ie.code = r.first.code;
+				ie.value = (keys[ie.code / bits] >> (ie.code % bits)) & 1;
+				dispatch(ie);
+			}
+		} else if (r.first.type != EV_ABS) {
+			continue;
+		} else if ((r.first.code > ABS_MT_SLOT) &&
+		(r.first.code <= ABS_MT_TOOL_Y)) {
+			if (slots > 0) {
+				mt[axes].code = r.first.code;
+				if (ioctl(fd, EVIOCGMTSLOTS(sizeof(mt[axes])), &mt[axes]) >= 0) {
+					++axes;
+				}
 			}
+		} else if (r.first.code != ABS_MT_SLOT) {
+			input_absinfo ai;
+			if (ioctl(fd, EVIOCGABS(r.first.code), &ai) >= 0) {
+				ie.type = EV_ABS;
+				ie.code = r.first.code;
+				ie.value = ai.value;
+				dispatch(ie);
+			}
+		}
+	}
+	if (axes) {
+		ie.type = EV_ABS;
+		for (int s = 0; s < slots; ++s) {
+			ie.code = ABS_MT_SLOT;
+			ie.value = s;
+			dispatch(ie);
+			for (int a = 0; a < axes; ++a) {
+				ie.code = mt[a].code;
+				ie.value = mt[a].values[s];
+				dispatch(ie);
+			}
+		}
+		input_absinfo ai;
+		if (ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &ai) >= 0) {
+			ie.code = ABS_MT_SLOT;
+			ie.value = ai.value;
+			dispatch(ie);
 		}
-	} while ((result >= 0) && (libevdev_has_event_pending(dev) > 0));
+	}
+	ie.type = EV_SYN;
+	ie.code = SYN_REPORT;
+	ie.value = 0;
+	dispatch(ie);
+}
+
+void Evdev::dispatch(const input_event &ie) {
+	TRACE_PROBE5(event_read, ie.type, ie.code, ie.value,
+		ie.input_event_sec, ie.input_event_usec);
+	FlightRecorder::input(ie.type, ie.code, ie.value,
+		ie.input_event_sec, ie.input_event_usec);
+	if (Log::enabled(Log::Trace)) {
+		Log::write(Log::Trace, "event %s:%s %d",
+			libevdev_event_type_get_name(ie.type),
+			libevdev_event_code_get_name(ie.type, ie.code),
+			ie.value
+		);
+	}
+	evtime = (std::int64_t)ie.input_event_sec * 1000000 +
+		ie.input_event_usec;
+	EventTypeCode etc(ie.type, ie.code);
+	InputMap::const_iterator iter = receivers.find(etc);
+	if (iter != receivers.end()) {
+		iter->second(etc, ie.value);
+	}
 }
 
 std::string Evdev::name() const {
@@ -123,7 +276,21 @@ int Evdev::value(unsigned int et, unsigned int ec) const {
 }
 
 void Evdev::usePoller(Poller &p) {
-	p.add(shared_from_this(), fd);
+	if (p.backend() == Poller::Uring) {
+		// lets the kernel read during the poller's wait rather than on one
+		// of its worker threads; the poller links a poll ahead of each read
+		// so that the read still waits for data
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+	p.addReader(shared_from_this(), fd);
+	poller = &p;
+}
+
+void Evdev::removeFromPoller() {
+	if (poller) {
+		poller->remove(fd);
+		poller = nullptr;
+	}
 }
 
 const input_absinfo *Evdev::absInfo(unsigned int absEc) const {
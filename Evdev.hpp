@@ -9,6 +9,9 @@
  *
  * Copyright (C) 2018  Jeff Jackowski
  */
+#ifndef EVDEV_HPP
+#define EVDEV_HPP
+
 #include <libevdev/libevdev.h>
 #include <boost/signals2/signal.hpp>
 #include "Poller.hpp"
@@ -63,17 +66,70 @@ public:
 protected:
 	typedef std::map<EventTypeCode, InputSignal>  InputMap;
 	InputMap receivers;
+	/**
+	 * Called when the device is no longer usable, such as after it was
+	 * unplugged.
+	 */
+	std::function<void()> lost;
+	/**
+	 * The poller given to usePoller(), if any.
+	 */
+	Poller *poller;
 	libevdev *dev;
 	int fd;
+	/**
+	 * True after the kernel reported dropping input read by received(),
+	 * until the end of the frame in progress.
+	 */
+	bool dropped;
+	/**
+	 * The time of the input event being dispatched in microseconds.
+	 */
+	std::int64_t evtime;
+	/**
+	 * Takes ownership of a libevdev object that has no device file, such as
+	 * one made with libevdev_new() and given its event codes by the caller.
+	 * Input is then supplied through dispatch() rather than read from a file.
+	 * @param device  The libevdev object. It is freed by the destructor.
+	 */
+	explicit Evdev(libevdev *device);
+	/**
+	 * Sends one input event to the receivers connected for its type and code.
+	 * This is the part of handling input that follows reading it.
+	 * @param ie  The input event.
+	 */
+	void dispatch(const input_event &ie);
+	/**
+	 * Sends the current state of the device's axes and keys that have
+	 * receivers as one frame of input. Used after input was dropped, since
+	 * libevdev does not see the input read by received().
+	 */
+	void resync();
 public:
 	Evdev(const std::string &path);
+	/**
+	 * Takes ownership of an already open device file, such as one handed
+	 * over by another process. A grab made through the file remains in
+	 * effect; do not call grab() again.
+	 * @param descriptor  The open device file.
+	 * @throw EvdevInitError  libevdev could not use the file. It is closed.
+	 */
+	explicit Evdev(int descriptor);
 	Evdev(Evdev &&e);
 	~Evdev();
 	Evdev &operator=(Evdev &&old);
 	/**
-	 * Reads in input events when invoked by the poller.
+	 * Reads in input events when invoked by the poller. If the device has
+	 * gone away, it is removed from the poller and the function given to
+	 * onLost() is called.
 	 */
 	virtual void respond(int fd);
+	/**
+	 * Handles input events read by the poller's io_uring. If the read
+	 * failed, the device is removed from the poller and the function given
+	 * to onLost() is called.
+	 */
+	virtual void received(int fd, const void *data, int size);
 	/**
 	 * Reports the name of the device through libevdev_get_name().
 	 */
@@ -83,12 +139,42 @@ public:
 	 * @return  True if exclusive access was granted.
 	 */
 	bool grab();
+	/**
+	 * The device's file descriptor.
+	 */
+	int descriptor() const {
+		return fd;
+	}
+	/**
+	 * The time the kernel gave the input event being sent to the receivers,
+	 * in microseconds on the monotonic clock, or zero if the event has no
+	 * time. Receivers use it to time input by when it happened rather than
+	 * when it was read, since several frames may be read at once.
+	 */
+	std::int64_t eventTime() const {
+		return evtime;
+	}
 	bool hasEventType(unsigned int et) const;
 	bool hasEventCode(unsigned int et, unsigned int ec) const;
 	bool hasEvent(EventTypeCode etc) const;
 	int numSlots() const;
 	int value(unsigned int et, unsigned int ec) const;
+	/**
+	 * Gets input through the poller. If it uses io_uring, the device file is
+	 * made non-blocking and read by the poller; respond() is then not used.
+	 */
 	void usePoller(Poller &p);
+	/**
+	 * Stops getting input through the poller given to usePoller().
+	 */
+	void removeFromPoller();
+	/**
+	 * Sets a function to call when the device is no longer usable. It is
+	 * called from respond() after the device is removed from the poller.
+	 */
+	void onLost(const std::function<void()> &f) {
+		lost = f;
+	}
 	boost::signals2::connection inputConnect(
 		EventTypeCode etc,
 		const InputSignal::slot_type &slot,
@@ -108,3 +194,5 @@ public:
 };
 
 typedef std::shared_ptr<Evdev>  EvdevShared;
+
+#endif        //  #ifndef EVDEV_HPP
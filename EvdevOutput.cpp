@@ -10,68 +10,290 @@
  * Copyright (C) 2018  Jeff Jackowski
  */
 #include "EvdevOutput.hpp"
+#include "AllocCount.hpp"
+#include "FlightRecorder.hpp"
+#include "Trace.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
-EvdevOutput::EvdevOutput(const Evdev &e) : flags(0) {
-	outdev = libevdev_new();
-	libevdev_set_name(outdev, "Screentouch: Touch to mouse translator");
-	addType(EV_ABS);
-	input_absinfo ia = *e.absInfo(ABS_X);
-	addCode(EV_ABS, ABS_X, &ia);
-	ia = *e.absInfo(ABS_Y);
-	addCode(EV_ABS, ABS_Y, &ia);
-	addType(EV_REL);
-	addCode(EV_REL, REL_WHEEL);
-	addCode(EV_REL, REL_HWHEEL);
-	addType(EV_KEY);
-	addCode(EV_KEY, BTN_LEFT);
-	addCode(EV_KEY, BTN_MIDDLE);
-	addCode(EV_KEY, BTN_RIGHT);
-	addType(EV_SYN);
-	addCode(EV_SYN, SYN_REPORT);
-	if (libevdev_uinput_create_from_device(
-		outdev,
-		LIBEVDEV_UINPUT_OPEN_MANAGED,
-		&uoutdev
-	)) {
-		BOOST_THROW_EXCEPTION(EvdevUInputCreateError());
-	}
+EvdevOutput::EvdevOutput(OutputSinkPtr &&s) : sink(std::move(s)),
+poller(nullptr), wakefd(-1), waiting(false), stopping(false), writeErrors(0), stats(), flags(0) {
+	frame.count = 0;
+	backlogFirst = backlogCount = 0;
+}
+
+/**
+ * Adds one to the counter of the writer thread's eventfd. Only an interrupted
+ * write is tried again; the counter cannot overflow from these increments.
+ */
+static void wakeWriter(int fd) {
+	std::uint64_t one = 1;
+	while ((write(fd, &one, sizeof(one)) < 0) && (errno == EINTR)) { }
 }
 
 EvdevOutput::~EvdevOutput() {
-	libevdev_uinput_destroy(uoutdev);
-	libevdev_free(outdev);
+	stopPipeline();
 }
 
-void EvdevOutput::addType(int t) {
-	if (libevdev_enable_event_type(outdev, t)) {
-		BOOST_THROW_EXCEPTION(EvdevTypeAddError() <<
-			EvdevEventType(t) <<
-			EvdevEventTypeName(libevdev_event_type_get_name(t))
-		);
+void EvdevOutput::stopPipeline() {
+	if (writer.joinable()) {
+		stopping = true;
+		wakeWriter(wakefd);
+		writer.join();
+		stopping = false;
+		if (poller) {
+			sink->usePoller(poller);
+		}
+	}
+	if (wakefd >= 0) {
+		close(wakefd);
+		wakefd = -1;
+	}
+	ring.reset();
+	// key changes that never fit in the queue
+	for (; backlogCount; --backlogCount, ++backlogFirst) {
+		const Frame &b = backlog[backlogFirst];
+		try {
+			sink->write(b.events, b.count);
+		} catch (...) {
+			++writeErrors;
+		}
 	}
+	backlogFirst = 0;
 }
 
-void EvdevOutput::addCode(int t, int c, const void *p) {
-	if (libevdev_enable_event_code(outdev, t, c, p)) {
-		BOOST_THROW_EXCEPTION(EvdevCodeAddError() <<
-			EvdevEventType(t) <<
-			EvdevEventTypeName(libevdev_event_type_get_name(t)) <<
-			EvdevEventCode(c) <<
-			EvdevEventCodeName(libevdev_event_code_get_name(t, c))
+void EvdevOutput::startPipeline() {
+	if (writer.joinable()) {
+		return;
+	}
+	wakefd = eventfd(0, EFD_CLOEXEC);
+	if (wakefd < 0) {
+		BOOST_THROW_EXCEPTION(EvdevError() <<
+			boost::errinfo_errno(errno)
 		);
 	}
+	ring.reset(new FrameRing);
+	// the writer thread does not wait on the poller
+	sink->usePoller(nullptr);
+	writer = std::thread(&EvdevOutput::writerLoop, this);
+}
+
+void EvdevOutput::usePoller(Poller &p) {
+	poller = &p;
+	if (!pipelined()) {
+		sink->usePoller(poller);
+	}
+}
+
+EvdevOutput::PipelineStats EvdevOutput::pipelineStats() const {
+	PipelineStats ps = stats;
+	ps.writeErrors = writeErrors;
+	return ps;
+}
+
+void EvdevOutput::writerLoop() {
+	do {
+		const Frame *f;
+		AllocCount::HotPath hp;
+		while ((f = ring->front()) != nullptr) {
+			try {
+				sink->write(f->events, f->count);
+			} catch (...) {
+				++writeErrors;
+			}
+			ring->pop();
+		}
+		if (stopping) {
+			return;
+		}
+		// announce the intent to sleep, then check for work again in case a
+		// frame was queued before the producer could see the announcement
+		waiting = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ring->empty() && !stopping) {
+			std::uint64_t count;
+			// an interrupted read loops around to check the ring again; any
+			// other failure would leave this loop spinning, so poll instead
+			if ((read(wakefd, &count, sizeof(count)) < 0) && (errno != EINTR)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		waiting = false;
+	} while (true);
+}
+
+void EvdevOutput::flush() {
+	if (!frame.count) {
+		return;
+	}
+	try {
+		deliver(frame);
+	} catch (...) {
+		// the frame is done even if the sink fails
+		frame.count = 0;
+		throw;
+	}
+	frame.count = 0;
+}
+
+void EvdevOutput::send(const Frame &f) {
+	flush();
+	for (int i = 0; i < f.count; ++i) {
+		FlightRecorder::output(f.events[i].type, f.events[i].code, f.events[i].value);
+	}
+	deliver(f);
+}
+
+/**
+ * True if the frame changes a key or button, or has relative motion like
+ * wheel events; such frames are not superseded by the frames that follow.
+ */
+static bool lasting(const EvdevOutput::Frame &f) {
+	for (int i = 0; i < f.count; ++i) {
+		if ((f.events[i].type == EV_KEY) || (f.events[i].type == EV_REL)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void EvdevOutput::deliver(const Frame &f) {
+	if (!ring) {
+		TRACE_PROBE3(flush, f.count, 0, 0);
+		sink->write(f.events, f.count);
+		return;
+	}
+	bool keys = lasting(f);
+	// frames left over from a full queue go ahead of anything newer
+	if (backlogCount && !drainBacklog()) {
+		if (keys) {
+			fold(f);
+		} else {
+			++stats.dropped;
+			TRACE_PROBE3(flush, f.count, 1, FrameRing::capacity());
+		}
+		return;
+	}
+	if (keys) {
+		if (!enqueue(f, FrameRing::capacity())) {
+			fold(f);
+		}
+	} else if (!enqueue(f, FrameRing::capacity() - keyReserve)) {
+		// motion is superseded by the frames that follow
+		++stats.dropped;
+		TRACE_PROBE3(flush, f.count, 1, FrameRing::capacity());
+	}
+}
+
+bool EvdevOutput::enqueue(const Frame &f, std::size_t limit) {
+	if ((ring->size() >= limit) || !ring->push(f)) {
+		return false;
+	}
+	++stats.frames;
+	std::uint64_t size = ring->size();
+	TRACE_PROBE3(flush, f.count, 1, size);
+	if (size > stats.highWater) {
+		stats.highWater = size;
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting) {
+		wakeWriter(wakefd);
+	}
+	return true;
+}
+
+bool EvdevOutput::drainBacklog() {
+	for (; backlogCount; --backlogCount, ++backlogFirst) {
+		if (!enqueue(backlog[backlogFirst], FrameRing::capacity())) {
+			return false;
+		}
+	}
+	backlogFirst = 0;
+	return true;
+}
+
+/**
+ * True if the frame has a change to the given key.
+ */
+static bool changesKey(const EvdevOutput::Frame &f, int code) {
+	for (int i = 0; i < f.count; ++i) {
+		if ((f.events[i].type == EV_KEY) && (f.events[i].code == code)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void EvdevOutput::fold(const Frame &f) {
+	++stats.folded;
+	Frame *b = backlogCount ? &backlog[backlogFirst + backlogCount - 1] :
+		nullptr;
+	// a second change to a key in one frame would hide the first, so such a
+	// frame starts a new one if there is room
+	bool merge = b && (b->count + f.count <= maxFrameEvents);
+	for (int i = 0; merge && (i < f.count); ++i) {
+		merge = (f.events[i].type != EV_KEY) ||
+			!changesKey(*b, f.events[i].code);
+	}
+	// the backlog is empty when b is null, so there is always room then
+	if (!merge && (backlogFirst + backlogCount < backlogFrames)) {
+		b = &backlog[backlogFirst + backlogCount++];
+		b->count = 0;
+	}
+	// the SYN_REPORT is put back at the end
+	if (b->count && (b->events[b->count - 1].type == EV_SYN)) {
+		--b->count;
+	}
+	for (int i = 0; i < f.count; ++i) {
+		const input_event &ie = f.events[i];
+		if (
+			(ie.type != EV_KEY) && (ie.type != EV_ABS) &&
+			(ie.type != EV_REL)
+		) {
+			continue;
+		}
+		int j = 0;
+		while (
+			(j < b->count) && (
+				(b->events[j].type != ie.type) ||
+				(b->events[j].code != ie.code)
+			)
+		) {
+			++j;
+		}
+		if (j == b->count) {
+			if (b->count < maxFrameEvents - 1) {
+				b->events[b->count++] = ie;
+			}
+		} else if (ie.type == EV_REL) {
+			b->events[j].value += ie.value;
+		} else {
+			// only reached for keys when the backlog is full
+			b->events[j].value = ie.value;
+		}
+	}
+	input_event &syn = b->events[b->count++];
+	syn.input_event_sec = 0;
+	syn.input_event_usec = 0;
+	syn.type = EV_SYN;
+	syn.code = SYN_REPORT;
+	syn.value = 0;
 }
 
 void EvdevOutput::set(const EventTypeCode &etc, std::int32_t val) {
-	if (libevdev_uinput_write_event(uoutdev, etc.type, etc.code, val)) {
-		BOOST_THROW_EXCEPTION(EvdevError() <<
-			EvdevEventType(etc.type) <<
-			EvdevEventTypeName(etc.typeName()) <<
-			EvdevEventCode(etc.code) <<
-			EvdevEventCodeName(etc.codeName()) <<
-			EvdevEventValue(val)
-		);
+	if (frame.count == maxFrameEvents) {
+		flush();
 	}
+	FlightRecorder::output(etc.type, etc.code, val);
+	input_event &ie = frame.events[frame.count++];
+	// the kernel supplies the time
+	ie.input_event_sec = 0;
+	ie.input_event_usec = 0;
+	ie.type = etc.type;
+	ie.code = etc.code;
+	ie.value = val;
 	// record changes to mouse button states for use in debugging output
 	if (etc.type == EV_KEY) {
 		int b = etc.code - BTN_LEFT;
@@ -84,7 +306,7 @@ void EvdevOutput::set(const EventTypeCode &etc, std::int32_t val) {
 int EvdevOutput::get(const EventTypeCode &etc) const {
 	int b = etc.code - BTN_LEFT;
 	if ((b >= 0) && (b < 3)) {
-		return flags & (1 << b);
+		return (flags >> b) & 1;
 	}
 	return 0;
 }
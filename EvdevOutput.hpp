@@ -9,65 +9,232 @@
  *
  * Copyright (C) 2018  Jeff Jackowski
  */
+#ifndef EVDEVOUTPUT_HPP
+#define EVDEVOUTPUT_HPP
+
 #include "Evdev.hpp"
-#include <libevdev/libevdev-uinput.h>
+#include "OutputSink.hpp"
+#include "SpscRing.hpp"
+#include <thread>
 
 /**
- * Outputs input events to a user-space input (uinput) device using libevdev.
- * Much of this class is very specific to the screentouch project, but it
- * could be refactored to be more generic.
+ * Collects output input events into frames and delivers them to an
+ * OutputSink, either directly or from a separate writer thread. The events
+ * that can be sent depend on the sink; UinputSink makes a device with the
+ * capabilities needed by the translator's settings.
  * @author  Jeff Jackowski
  */
 class EvdevOutput {
+public:
+	/**
+	 * The most events that will be held for a single frame. A frame with more
+	 * events is split.
+	 */
+	static constexpr int maxFrameEvents = 16;
+	/**
+	 * A batch of input events that are written together. Normally ends with
+	 * a SYN_REPORT event.
+	 */
+	struct Frame {
+		input_event events[maxFrameEvents];
+		int count;
+	};
+	/**
+	 * Counters describing the operation of the writer thread used by
+	 * startPipeline().
+	 */
+	struct PipelineStats {
+		/**
+		 * Frames given to the writer thread.
+		 */
+		std::uint64_t frames;
+		/**
+		 * Frames discarded because the writer thread fell too far behind.
+		 * Only frames of absolute motion are discarded.
+		 */
+		std::uint64_t dropped;
+		/**
+		 * Frames with key changes or relative motion that did not fit in
+		 * the queue and were kept in @a backlog.
+		 */
+		std::uint64_t folded;
+		/**
+		 * The most frames that were waiting on the writer thread.
+		 */
+		std::uint64_t highWater;
+		/**
+		 * Frames the writer thread failed to write.
+		 */
+		std::uint64_t writeErrors;
+	};
+private:
+	/**
+	 * Queue of frames from the translating thread to the writer thread.
+	 */
+	typedef SpscRing<Frame, 256>  FrameRing;
+	/**
+	 * Queue space that only frames with key changes or relative motion may
+	 * use, so that motion filling the queue does not cost a button release.
+	 */
+	static constexpr std::size_t keyReserve = 16;
+	/**
+	 * The most frames held in @a backlog.
+	 */
+	static constexpr int backlogFrames = 8;
+	/**
+	 * The destination of the output events.
+	 */
+	OutputSinkPtr sink;
 	/**
-	 * The input device that this object will create.
+	 * The poller given to usePoller(), if any.
 	 */
-	libevdev *outdev;
+	Poller *poller;
 	/**
-	 * The device to which input events will be output.
+	 * The frame currently being built by set().
 	 */
-	libevdev_uinput *uoutdev;
+	Frame frame;
+	/**
+	 * Frames waiting on the writer thread. Only allocated by startPipeline().
+	 */
+	std::unique_ptr<FrameRing> ring;
+	/**
+	 * Frames with key changes or relative motion that did not fit in
+	 * @a ring, in order. Queued ahead of the next frame so that no click is
+	 * lost and no button or modifier stays pressed.
+	 */
+	Frame backlog[backlogFrames];
+	/**
+	 * The index of the oldest frame in @a backlog.
+	 */
+	int backlogFirst;
+	/**
+	 * The number of frames in @a backlog.
+	 */
+	int backlogCount;
+	/**
+	 * The thread that writes frames to the output device when the pipeline
+	 * is in use.
+	 */
+	std::thread writer;
+	/**
+	 * An eventfd used to wake the writer thread when it has run out of work.
+	 */
+	int wakefd;
+	/**
+	 * True while the writer thread is, or is about to be, blocked on
+	 * @a wakefd.
+	 */
+	std::atomic<bool> waiting;
+	/**
+	 * Tells the writer thread to finish the queued frames and exit.
+	 */
+	std::atomic<bool> stopping;
+	/**
+	 * Frames the writer thread failed to write.
+	 */
+	std::atomic<std::uint64_t> writeErrors;
+	/**
+	 * Counters maintained by the translating thread.
+	 */
+	PipelineStats stats;
 	/**
 	 * Used to track mouse button states for debugging.
 	 */
 	int flags;
 	/**
-	 * Adds an event type to the input device.
-	 * @param t  The event type, such as EV_KEY.
-	 * @throw    EvdevTypeAddError  libevdev reported an error with the
-	 *                              add attempt.
+	 * Gives the current frame to the sink, or to the writer thread if the
+	 * pipeline is in use, then starts a new frame.
+	 * @throw EvdevError  The sink failed. Only thrown when not using the
+	 *                    pipeline.
+	 */
+	void flush();
+	/**
+	 * Gives a frame to the sink, or to the writer thread if the pipeline is
+	 * in use.
+	 * @throw EvdevError  The sink failed. Only thrown when not using the
+	 *                    pipeline.
 	 */
-	void addType(int t);
+	void deliver(const Frame &f);
 	/**
-	 * Adds an event code to the input device.
-	 * @param t  The event type, such as EV_KEY.
-	 * @param c  The event code, such as BTN_LEFT.
-	 * @param p  A pointer to a input_absinfo struct (defined in Linux kernel
-	 *           code) if the event type is EV_ABS, otherwise it must be nullptr.
-	 *           The data in the input_absinfo struct will be copied, so it need
-	 *           not be maintained.
-	 * @throw    EvdevCodeAddError  libevdev reported an error with the
-	 *                              add attempt.
+	 * Queues a frame for the writer thread if the queue holds fewer than
+	 * @a limit frames.
+	 * @return  True if queued.
 	 */
-	void addCode(int t, int c, const void *p = nullptr);
+	bool enqueue(const Frame &f, std::size_t limit);
+	/**
+	 * Adds a frame to @a backlog. The frame is merged into the last frame
+	 * there unless that would combine two changes to the same key, so that
+	 * every press and release is kept in order; absolute axes keep their
+	 * latest value and relative axes are summed. If @a backlog is full, the
+	 * frame is merged regardless and only the latest state of each key
+	 * remains.
+	 */
+	void fold(const Frame &f);
+	/**
+	 * Queues the frames in @a backlog for the writer thread.
+	 * @return  True if all were queued.
+	 */
+	bool drainBacklog();
+	/**
+	 * The body of the writer thread.
+	 */
+	void writerLoop();
 public:
 	/**
-	 * Makes a new input device to output input events specifically for the
-	 * screentouch project.
-	 * @param e  The touchscreen input device. Needed to query for input_absinfo
-	 *           data on the axes.
+	 * @param s  The destination of the output events.
 	 */
-	EvdevOutput(const Evdev &e);
+	EvdevOutput(OutputSinkPtr &&s);
 	/**
-	 * Destroys created input devices.
+	 * Stops the writer thread, if any, after it delivers the queued frames,
+	 * and then destroys the sink.
 	 */
 	~EvdevOutput();
 	/**
-	 * Sends an input event.
+	 * The destination of the output events. It must not be used while the
+	 * pipeline is running.
+	 */
+	OutputSink &outputSink() const {
+		return *sink;
+	}
+	/**
+	 * Starts a separate thread to write output events so that a slow reader
+	 * of the output device will not delay reading the touchscreen. Frames are
+	 * passed to the thread through a bounded queue; if it fills, frames of
+	 * absolute motion alone are discarded rather than blocking the caller.
+	 * Frames with key changes or relative motion use space kept for them,
+	 * and if even that is full, they are held in order and sent once there
+	 * is room.
+	 */
+	void startPipeline();
+	/**
+	 * Stops the writer thread, if any, after it delivers the queued frames.
+	 * Later frames are written directly, or through the poller given to
+	 * usePoller().
+	 */
+	void stopPipeline();
+	/**
+	 * Lets the sink write through the poller when the pipeline is not
+	 * running. The poller must outlast this object.
+	 */
+	void usePoller(Poller &p);
+	/**
+	 * True if the writer thread is running.
+	 */
+	bool pipelined() const {
+		return writer.joinable();
+	}
+	/**
+	 * Reports the writer thread's counters. All are zero if startPipeline()
+	 * has not been called.
+	 */
+	PipelineStats pipelineStats() const;
+	/**
+	 * Adds an input event to the current frame. The frame is sent by sync().
 	 */
 	void set(const EventTypeCode &etc, std::int32_t val);
 	/**
 	 * Queries mouse button states for debugging.
+	 * @return  1 if the left, right, or middle button is pressed, or 0.
 	 */
 	int get(const EventTypeCode &etc) const;
 	/**
@@ -78,5 +245,14 @@ public:
 	 */
 	void sync() {
 		set(EventTypeCode(EV_SYN, SYN_REPORT), 0);
+		flush();
 	}
+	/**
+	 * Sends a batch of events prepared ahead of time, such as a Chord, in
+	 * a single write after any events given to set() but not yet synced.
+	 * @param f  The events; they should end with a SYN_REPORT.
+	 */
+	void send(const Frame &f);
 };
+
+#endif        //  #ifndef EVDEVOUTPUT_HPP
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "FlightRecorder.hpp"
+#include <csignal>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+FlightRecorder *FlightRecorder::current = nullptr;
+
+/**
+ * The signals that indicate a crash.
+ */
+static const int crashSignals[] = {
+	SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT
+};
+
+FlightRecorder::FlightRecorder(
+	const std::string &file,
+	std::size_t capacity
+) :
+head(0), stamp(0), path(file), crashPath(file + ".crash"),
+tempPath(path + ".tmp"), crashTempPath(crashPath + ".tmp") {
+	std::size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	mask = size - 1;
+	ring.reset(new Record[size]);
+	// fault in the pages now rather than when recording
+	std::memset(ring.get(), 0, size * sizeof(Record));
+	current = this;
+}
+
+FlightRecorder::~FlightRecorder() {
+	if (current == this) {
+		current = nullptr;
+	}
+}
+
+bool FlightRecorder::write(const char *file, const char *temp) const {
+	std::uint64_t total = head.load(std::memory_order_acquire);
+	std::uint64_t count = total > mask ? mask + 1 : total;
+	std::size_t start = (total - count) & mask;
+	Header hdr;
+	std::memcpy(hdr.magic, "STFLTREC", sizeof(hdr.magic));
+	hdr.version = 1;
+	hdr.recordSize = sizeof(Record);
+	hdr.count = count;
+	hdr.total = total;
+	// oldest records are at the end of the buffer when it has wrapped
+	std::size_t first = count < mask + 1 - start ? count : mask + 1 - start;
+	iovec iov[3] = {
+		{ &hdr, sizeof(hdr) },
+		{ &ring[start], first * sizeof(Record) },
+		{ &ring[0], (count - first) * sizeof(Record) }
+	};
+	// removes a left over file or link; the file must then be made anew
+	unlink(temp);
+	int fd = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+		0644);
+	if (fd < 0) {
+		return false;
+	}
+	std::size_t want = 0;
+	for (const iovec &v : iov) {
+		want += v.iov_len;
+	}
+	bool good = writev(fd, iov, 3) == (ssize_t)want;
+	close(fd);
+	// replaces the file, or a link at its name, rather than the link's target
+	if (!good || (rename(temp, file) < 0)) {
+		unlink(temp);
+		return false;
+	}
+	return true;
+}
+
+void FlightRecorder::signalHandler(int sig) {
+	int err = errno;
+	if (current) {
+		if (sig == SIGUSR1) {
+			current->write(current->path.c_str(), current->tempPath.c_str());
+		} else {
+			current->write(current->crashPath.c_str(),
+				current->crashTempPath.c_str());
+		}
+	}
+	if (sig != SIGUSR1) {
+		// the handler was reset when called; let the default action occur
+		raise(sig);
+	}
+	errno = err;
+}
+
+void FlightRecorder::installSignalHandlers() {
+	struct sigaction sa = { };
+	sa.sa_handler = &signalHandler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, nullptr);
+	sa.sa_flags = SA_RESETHAND;
+	for (int sig : crashSignals) {
+		sigaction(sig, &sa, nullptr);
+	}
+}
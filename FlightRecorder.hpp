@@ -0,0 +1,252 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef FLIGHTRECORDER_HPP
+#define FLIGHTRECORDER_HPP
+
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Keeps the most recent raw input events and the translator's decisions in a
+ * fixed-size ring so that they can be examined after something goes wrong.
+ * The storage is allocated by the constructor; recording a record only
+ * copies 16 bytes and never allocates, formats, or makes a system call.
+ *
+ * The ring may be written to a file on request with dump(), on SIGUSR1, or
+ * when the program crashes. The file has a Header followed by the Record
+ * structures, oldest first, in the host's byte order. All times are
+ * nanoseconds of CLOCK_MONOTONIC; touchscreens are read using that clock so
+ * that input event times match the other records.
+ *
+ * Only one recorder is in use at a time. Records are only added from the
+ * thread that reads the touchscreen.
+ * @author  Jeff Jackowski
+ */
+class FlightRecorder : boost::noncopyable {
+public:
+	/**
+	 * The kinds of records.
+	 */
+	enum Kind : std::uint8_t {
+		/**
+		 * An event read from the touchscreen.
+		 */
+		Input,
+		/**
+		 * An event given to the output.
+		 */
+		Output,
+		/**
+		 * A change of the translator's operation. The code is the new
+		 * operation, and the value is the old operation, using the values of
+		 * MtTranslate::Operation.
+		 */
+		Operation
+	};
+	/**
+	 * A recorded event or decision.
+	 */
+	struct Record {
+		/**
+		 * Nanoseconds of CLOCK_MONOTONIC.
+		 */
+		std::int64_t time;
+		/**
+		 * A value from Kind.
+		 */
+		std::uint8_t kind;
+		/**
+		 * The input event type, or zero.
+		 */
+		std::uint8_t type;
+		std::uint16_t code;
+		std::int32_t value;
+	};
+	static_assert(sizeof(Record) == 16, "Record must be 16 bytes");
+	/**
+	 * The start of a dump file.
+	 */
+	struct Header {
+		/**
+		 * "STFLTREC"; not terminated.
+		 */
+		char magic[8];
+		/**
+		 * The format version; currently 1.
+		 */
+		std::uint32_t version;
+		/**
+		 * The size of a Record.
+		 */
+		std::uint32_t recordSize;
+		/**
+		 * The number of records that follow.
+		 */
+		std::uint64_t count;
+		/**
+		 * The total number of records made, including those that were
+		 * overwritten.
+		 */
+		std::uint64_t total;
+	};
+	/**
+	 * The default number of records kept; a power of two.
+	 */
+	static constexpr std::size_t defaultCapacity = 65536;
+private:
+	/**
+	 * The recorder in use, if any.
+	 */
+	static FlightRecorder *current;
+	/**
+	 * The records.
+	 */
+	std::unique_ptr<Record[]> ring;
+	/**
+	 * The number of records made; also locates the next record.
+	 */
+	std::atomic<std::uint64_t> head;
+	/**
+	 * The time used for records that are not given a time.
+	 */
+	std::int64_t stamp;
+	/**
+	 * One less than the capacity.
+	 */
+	std::size_t mask;
+	/**
+	 * The file written by dump().
+	 */
+	std::string path;
+	/**
+	 * The file written when crashing.
+	 */
+	std::string crashPath;
+	/**
+	 * The temporary files written before being renamed to path and
+	 * crashPath.
+	 */
+	std::string tempPath, crashTempPath;
+	/**
+	 * Writes the records to a file using only async-signal-safe calls. The
+	 * records are written to a newly made temporary file that then replaces
+	 * the file, so that a symbolic link or other file placed at either name
+	 * is never written through.
+	 * @param file  The file to replace.
+	 * @param temp  The temporary file; it is removed first if it exists.
+	 */
+	bool write(const char *file, const char *temp) const;
+	/**
+	 * Handles the signals given to installSignalHandlers().
+	 */
+	static void signalHandler(int sig);
+	void add(Kind k, int type, int code, std::int32_t value, std::int64_t t) {
+		std::uint64_t h = head.load(std::memory_order_relaxed);
+		Record &r = ring[h & mask];
+		r.time = t;
+		r.kind = k;
+		r.type = (std::uint8_t)type;
+		r.code = (std::uint16_t)code;
+		r.value = value;
+		head.store(h + 1, std::memory_order_release);
+	}
+public:
+	/**
+	 * Makes the recorder and puts it into use.
+	 * @param file      The file written by dump(). When crashing, ".crash" is
+	 *                  added to the name. Both are first written with ".tmp"
+	 *                  added to the name.
+	 * @param capacity  The number of records kept. It is rounded up to a
+	 *                  power of two.
+	 */
+	FlightRecorder(
+		const std::string &file,
+		std::size_t capacity = defaultCapacity
+	);
+	/**
+	 * Takes the recorder out of use.
+	 */
+	~FlightRecorder();
+	/**
+	 * The recorder in use, or nullptr.
+	 */
+	static FlightRecorder *active() {
+		return current;
+	}
+	/**
+	 * Dumps the ring to the file when SIGUSR1 is received, and to the crash
+	 * file when a crash signal is received. The crash signals are then
+	 * handled as they would have been without the recorder.
+	 */
+	static void installSignalHandlers();
+	/**
+	 * Writes the records to the file given to the constructor.
+	 * @return  True on success.
+	 */
+	bool dump() const {
+		return write(path.c_str(), tempPath.c_str());
+	}
+	/**
+	 * The file written by dump().
+	 */
+	const std::string &file() const {
+		return path;
+	}
+	/**
+	 * Sets the time used for following records that are not given a time.
+	 */
+	static void now(std::chrono::steady_clock::time_point t) {
+		if (current) {
+			current->stamp = std::chrono::duration_cast<
+				std::chrono::nanoseconds
+			>(t.time_since_epoch()).count();
+		}
+	}
+	/**
+	 * Records an event read from the touchscreen. The time of the event
+	 * becomes the time used for following records.
+	 */
+	static void input(
+		int type,
+		int code,
+		std::int32_t value,
+		long sec,
+		long usec
+	) {
+		if (current) {
+			current->stamp = (std::int64_t)sec * 1000000000 + usec * 1000;
+			current->add(Input, type, code, value, current->stamp);
+		}
+	}
+	/**
+	 * Records an event given to the output.
+	 */
+	static void output(int type, int code, std::int32_t value) {
+		if (current) {
+			current->add(Output, type, code, value, current->stamp);
+		}
+	}
+	/**
+	 * Records a change of operation.
+	 */
+	static void operation(int oldOp, int newOp) {
+		if (current) {
+			current->add(Operation, 0, newOp, oldOp, current->stamp);
+		}
+	}
+};
+
+#endif        //  #ifndef FLIGHTRECORDER_HPP
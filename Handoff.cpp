@@ -0,0 +1,256 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Handoff.hpp"
+#include "Log.hpp"
+#include "UinputSink.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <cstddef>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char magic[8] = { 'S', 'T', 'H', 'A', 'N', 'D', 'O', 'F' };
+
+/**
+ * Changes when the layout of Handoff::Message or MtTranslate::Snapshot
+ * changes. A snapshot from a different version is not used.
+ */
+static const std::uint32_t messageVersion = 1;
+
+/**
+ * How long, in milliseconds, either process waits on the other.
+ */
+static const int waitTime = 5000;
+
+/**
+ * Space for the touchscreen and uinput file descriptors.
+ */
+union FdControl {
+	cmsghdr align;
+	char buf[CMSG_SPACE(2 * sizeof(int))];
+};
+
+Handoff::Handoff(
+	Poller &p,
+	const DeviceManagerShared &dm,
+	const std::string &file
+) : poller(p), devman(dm), path(file) {
+	sockaddr_un addr = { };
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		BOOST_THROW_EXCEPTION(HandoffSocketError() <<
+			boost::errinfo_errno(ENAMETOOLONG) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	std::strcpy(addr.sun_path, path.c_str());
+	lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (lfd < 0) {
+		BOOST_THROW_EXCEPTION(HandoffSocketError() <<
+			boost::errinfo_errno(errno) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	// a socket left by an earlier run prevents bind(); any other file is
+	// kept, and causes bind() to fail
+	struct stat st;
+	if (!lstat(path.c_str(), &st) && S_ISSOCK(st.st_mode)) {
+		unlink(path.c_str());
+	}
+	// only the same user may connect
+	mode_t mask = umask(0177);
+	int result = bind(lfd, (const sockaddr*)&addr, sizeof(addr));
+	umask(mask);
+	if (result || listen(lfd, 1)) {
+		int err = errno;
+		close(lfd);
+		BOOST_THROW_EXCEPTION(HandoffSocketError() <<
+			boost::errinfo_errno(err) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+}
+
+Handoff::~Handoff() {
+	close(lfd);
+	unlink(path.c_str());
+}
+
+void Handoff::start() {
+	poller.add(shared_from_this(), lfd);
+}
+
+void Handoff::respond(int) {
+	int fd;
+	while ((fd = accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+		give(fd);
+	}
+}
+
+void Handoff::give(int fd) {
+	MtTranslate *mt = devman->translation();
+	if (!mt) {
+		// nothing to hand over
+		close(fd);
+		return;
+	}
+	Message msg;
+	std::memset(&msg, 0, sizeof(msg));
+	std::memcpy(msg.magic, magic, sizeof(magic));
+	msg.version = messageVersion;
+	std::strncpy(msg.device, devman->device().c_str(), sizeof(msg.device) - 1);
+	// queued output must reach the device before the new process writes
+	EvdevOutput &eo = mt->output();
+	bool pipelined = eo.pipelined();
+	eo.stopPipeline();
+	mt->save(msg.snapshot);
+	// with io_uring, output like the button releases queued by save() is
+	// only written when submitted, and the outstanding read of the
+	// touchscreen would take input that arrives while waiting for the new
+	// process
+	poller.submit();
+	devman->touchscreen()->removeFromPoller();
+	int fds[2] = { devman->touchscreen()->descriptor(), -1 };
+	UinputSink *us = dynamic_cast<UinputSink*>(&eo.outputSink());
+	if (us) {
+		fds[1] = us->descriptor();
+		msg.hasUinput = 1;
+	}
+	int count = msg.hasUinput ? 2 : 1;
+	iovec iov = { &msg, sizeof(msg) };
+	FdControl ctl;
+	std::memset(&ctl, 0, sizeof(ctl));
+	msghdr mh = { };
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctl.buf;
+	mh.msg_controllen = CMSG_SPACE(count * sizeof(int));
+	cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(count * sizeof(int));
+	std::memcpy(CMSG_DATA(cm), fds, count * sizeof(int));
+	if (sendmsg(fd, &mh, MSG_NOSIGNAL) == (ssize_t)sizeof(msg)) {
+		// input is not handled while waiting, so none is lost or handled
+		// twice; the new process reads whatever arrives in the meantime
+		pollfd pfd = { fd, POLLIN, 0 };
+		char ack;
+		if ((poll(&pfd, 1, waitTime) == 1) && (read(fd, &ack, 1) == 1)) {
+			Log::write(Log::Info, "handed the touchscreen to a new process");
+			Log::stop();
+			// exit without closing the devices properly; that would release
+			// the grab and remove the uinput device
+			_exit(0);
+		}
+	}
+	// the new process failed; keep going
+	close(fd);
+	devman->touchscreen()->usePoller(poller);
+	Log::write(Log::Error, "handoff to a new process failed");
+	if (pipelined) {
+		eo.startPipeline();
+	}
+}
+
+Handoff::Taken Handoff::take(const std::string &file) {
+	sockaddr_un addr = { };
+	addr.sun_family = AF_UNIX;
+	if (file.size() >= sizeof(addr.sun_path)) {
+		BOOST_THROW_EXCEPTION(HandoffTakeError() <<
+			boost::errinfo_errno(ENAMETOOLONG) <<
+			boost::errinfo_file_name(file)
+		);
+	}
+	std::strcpy(addr.sun_path, file.c_str());
+	int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0) {
+		BOOST_THROW_EXCEPTION(HandoffTakeError() <<
+			boost::errinfo_errno(errno) <<
+			boost::errinfo_file_name(file)
+		);
+	}
+	timeval tv = { waitTime / 1000, 0 };
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (connect(sock, (const sockaddr*)&addr, sizeof(addr))) {
+		int err = errno;
+		close(sock);
+		BOOST_THROW_EXCEPTION(HandoffTakeError() <<
+			boost::errinfo_errno(err) <<
+			boost::errinfo_file_name(file)
+		);
+	}
+	Message msg;
+	iovec iov = { &msg, sizeof(msg) };
+	FdControl ctl;
+	msghdr mh = { };
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctl.buf;
+	mh.msg_controllen = sizeof(ctl.buf);
+	ssize_t len = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+	int err = errno;
+	int fds[2] = { -1, -1 };
+	int count = 0;
+	if (len > 0) {
+		for (cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+			if ((cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SCM_RIGHTS)) {
+				count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				if (count > 2) {
+					count = 2;
+				}
+				std::memcpy(fds, CMSG_DATA(cm), count * sizeof(int));
+			}
+		}
+	}
+	if (
+		(len < (ssize_t)offsetof(Message, snapshot)) || !count ||
+		std::memcmp(msg.magic, magic, sizeof(magic))
+	) {
+		for (int i = 0; i < count; ++i) {
+			close(fds[i]);
+		}
+		close(sock);
+		BOOST_THROW_EXCEPTION(HandoffTakeError() <<
+			boost::errinfo_errno(len < 0 ? err : EPROTO) <<
+			boost::errinfo_file_name(file)
+		);
+	}
+	Taken t;
+	t.evdev = fds[0];
+	t.uinput = (msg.hasUinput && (count > 1)) ? fds[1] : -1;
+	t.sock = sock;
+	t.device.assign(msg.device, strnlen(msg.device, sizeof(msg.device)));
+	t.haveSnapshot = (msg.version == messageVersion) &&
+		(len == (ssize_t)sizeof(msg));
+	if (t.haveSnapshot) {
+		t.snapshot = msg.snapshot;
+	}
+	return t;
+}
+
+void Handoff::complete(Taken &t) {
+	char ack = 1;
+	ssize_t res;
+	do {
+		// the old process may already be gone; that must not raise SIGPIPE
+		res = send(t.sock, &ack, 1, MSG_NOSIGNAL);
+	} while ((res < 0) && (errno == EINTR));
+	if (res != 1) {
+		Log::write(Log::Error, "could not acknowledge the handoff to the old process");
+	}
+	close(t.sock);
+	t.sock = -1;
+}
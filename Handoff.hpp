@@ -0,0 +1,156 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef HANDOFF_HPP
+#define HANDOFF_HPP
+
+#include "DeviceManager.hpp"
+
+struct HandoffError : virtual std::exception, virtual boost::exception { };
+/**
+ * The socket for offering the touchscreen could not be made.
+ */
+struct HandoffSocketError : HandoffError { };
+/**
+ * The touchscreen could not be taken from another process.
+ */
+struct HandoffTakeError : HandoffError { };
+
+/**
+ * Passes the touchscreen, the uinput device, and the translator's state to
+ * a newly started process so that Screentouch can be restarted or upgraded
+ * without releasing the touchscreen or removing the output device.
+ *
+ * The running process listens on a Unix domain socket. A new process
+ * connects with take() and receives the open touchscreen and uinput file
+ * descriptors along with a MtTranslate::Snapshot. Once the new process has
+ * set itself up, it calls complete(), and the old process exits without
+ * closing either device. If the new process fails first, the old one
+ * continues.
+ * @author  Jeff Jackowski
+ */
+class Handoff :
+	boost::noncopyable,
+	public PollResponse,
+	public std::enable_shared_from_this<Handoff>
+{
+public:
+	/**
+	 * The message sent with the file descriptors.
+	 */
+	struct Message {
+		/**
+		 * Always "STHANDOF".
+		 */
+		char magic[8];
+		/**
+		 * Changes when the layout of this structure changes.
+		 */
+		std::uint32_t version;
+		/**
+		 * Non-zero if a uinput file descriptor follows the touchscreen's.
+		 */
+		std::uint32_t hasUinput;
+		/**
+		 * The touchscreen's device file, for reporting.
+		 */
+		char device[256];
+		MtTranslate::Snapshot snapshot;
+	};
+	/**
+	 * What take() got from the old process.
+	 */
+	struct Taken {
+		/**
+		 * The touchscreen, still grabbed.
+		 */
+		int evdev;
+		/**
+		 * The uinput device, or -1 if the old process was not using one.
+		 */
+		int uinput;
+		/**
+		 * The connection to the old process, used by complete().
+		 */
+		int sock;
+		/**
+		 * The touchscreen's device file.
+		 */
+		std::string device;
+		/**
+		 * True if @a snapshot came from a compatible version.
+		 */
+		bool haveSnapshot;
+		MtTranslate::Snapshot snapshot;
+	};
+private:
+	/**
+	 * The poller used for the socket.
+	 */
+	Poller &poller;
+	/**
+	 * The touchscreen and translator to hand over.
+	 */
+	DeviceManagerShared devman;
+	/**
+	 * The socket's file name.
+	 */
+	std::string path;
+	/**
+	 * The listening socket.
+	 */
+	int lfd;
+	/**
+	 * Sends everything over a new connection and exits if the new process
+	 * accepts.
+	 */
+	void give(int fd);
+public:
+	/**
+	 * Makes the listening socket. An existing socket file with the same name
+	 * is replaced. The socket is only usable by the same user.
+	 * @param p     The poller used for the socket.
+	 * @param dm    Has the touchscreen and translator to hand over.
+	 * @param file  The socket's file name.
+	 * @throw HandoffSocketError  The socket could not be made.
+	 */
+	Handoff(Poller &p, const DeviceManagerShared &dm, const std::string &file);
+	/**
+	 * Closes and removes the socket. Not called if the touchscreen was
+	 * handed over since the new process will have replaced the socket.
+	 */
+	~Handoff();
+	/**
+	 * Starts accepting connections.
+	 */
+	void start();
+	/**
+	 * Hands over the touchscreen to a new connection.
+	 */
+	virtual void respond(int fd);
+	/**
+	 * Connects to a running process and receives its touchscreen. The old
+	 * process stops handling input until complete() is called or the
+	 * connection is closed.
+	 * @param file  The socket's file name.
+	 * @throw HandoffTakeError  Nothing usable was received.
+	 */
+	static Taken take(const std::string &file);
+	/**
+	 * Tells the old process to exit, then closes the connection. Call once
+	 * the received devices are in use.
+	 */
+	static void complete(Taken &t);
+};
+
+typedef std::shared_ptr<Handoff>  HandoffShared;
+
+#endif        //  #ifndef HANDOFF_HPP
@@ -0,0 +1,231 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Log.hpp"
+#include "SpscRing.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+std::atomic<Log::Level> Log::verbosity(Log::Off);
+
+/**
+ * How long the background thread waits after being woken before writing, so
+ * that the records which follow the first are written together and do not
+ * each need a system call to wake the thread.
+ */
+static constexpr std::chrono::milliseconds writeInterval(20);
+
+static const char *levelNames[] = {
+	"off", "error", "info", "debug", "trace"
+};
+
+/**
+ * The queue of records and the thread that writes them out.
+ */
+static struct LogWriter {
+	SpscRing<Log::Record, 4096> ring;
+	std::thread thread;
+	/**
+	 * Serializes starting and stopping the thread.
+	 */
+	std::mutex block;
+	std::atomic<bool> stopping;
+	/**
+	 * True while the thread is, or is about to be, blocked on @a wakefd.
+	 */
+	std::atomic<bool> waiting;
+	/**
+	 * An eventfd used to wake the thread when a record arrives while it
+	 * waits. If it cannot be made, the thread polls every writeInterval.
+	 */
+	int wakefd;
+	/**
+	 * Records discarded because the queue was full. Only changed by the
+	 * producer.
+	 */
+	std::atomic<std::uint64_t> dropped;
+	/**
+	 * The value of @a dropped last reported by the writer thread.
+	 */
+	std::uint64_t reported;
+	LogWriter() : stopping(false), waiting(false),
+	wakefd(eventfd(0, EFD_CLOEXEC)), dropped(0), reported(0) { }
+	~LogWriter() {
+		stop();
+		if (wakefd >= 0) {
+			close(wakefd);
+		}
+	}
+	void wake() {
+		std::uint64_t one = 1;
+		// only an interrupted write needs another try; without an eventfd,
+		// the writer polls and needs no wake
+		while ((::write(wakefd, &one, sizeof(one)) < 0) && (errno == EINTR)) { }
+	}
+	void format(std::string &out, const Log::Record &r);
+	void drain();
+	void run();
+	void stop();
+} writer;
+
+void LogWriter::format(std::string &out, const Log::Record &r) {
+	char num[32];
+	std::snprintf(num, sizeof(num), "%lld.%06lld %s: ",
+		(long long)(r.time / 1000000000),
+		(long long)(r.time % 1000000000 / 1000),
+		levelNames[r.level]
+	);
+	out += num;
+	int a = 0;
+	for (const char *f = r.format; *f; ++f) {
+		if ((*f != '%') || !f[1]) {
+			out += *f;
+			continue;
+		}
+		switch (*++f) {
+			case 'd':
+			case 'x':
+				if (a < Log::maxArgs) {
+					std::snprintf(num, sizeof(num),
+						(*f == 'd') ? "%lld" : "%llx",
+						(long long)r.args[a++]
+					);
+					out += num;
+				}
+				break;
+			case 's':
+				if (a < Log::maxArgs) {
+					const char *s = (const char*)(std::intptr_t)r.args[a++];
+					out += s ? s : "(null)";
+				}
+				break;
+			case '%':
+				out += '%';
+				break;
+			default:
+				out += '%';
+				out += *f;
+		}
+	}
+	out += '\n';
+}
+
+void LogWriter::drain() {
+	std::string text;
+	const Log::Record *r;
+	while ((r = ring.front()) != nullptr) {
+		format(text, *r);
+		ring.pop();
+	}
+	std::uint64_t d = dropped.load(std::memory_order_relaxed);
+	if (d != reported) {
+		text += std::to_string(d - reported) + " log records discarded\n";
+		reported = d;
+	}
+	const char *ptr = text.data();
+	std::size_t left = text.size();
+	while (left) {
+		ssize_t result = ::write(STDERR_FILENO, ptr, left);
+		if (result <= 0) {
+			break;
+		}
+		ptr += result;
+		left -= result;
+	}
+}
+
+void LogWriter::run() {
+	bool done;
+	do {
+		done = stopping;
+		drain();
+		if (!done) {
+			// announce the intent to sleep, then check for records again in
+			// case one was queued before the producer could see it
+			waiting = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (ring.empty() && !stopping) {
+				// without an eventfd, this fails and the thread polls
+				std::uint64_t count;
+				while (
+					(::read(wakefd, &count, sizeof(count)) < 0) &&
+					(errno == EINTR) && !stopping
+				) { }
+			}
+			waiting = false;
+			if (!stopping) {
+				std::this_thread::sleep_for(writeInterval);
+			}
+		}
+	} while (!done);
+}
+
+void LogWriter::stop() {
+	std::lock_guard<std::mutex> lock(block);
+	if (thread.joinable()) {
+		stopping = true;
+		wake();
+		thread.join();
+		stopping = false;
+	}
+}
+
+void Log::push(const Record &r) {
+	if (writer.ring.push(r)) {
+		// the thread only waits once the queue is empty, so this system
+		// call is only made for the first record after an idle period
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (writer.waiting.load(std::memory_order_relaxed)) {
+			writer.wake();
+		}
+	} else {
+		writer.dropped.store(
+			writer.dropped.load(std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed
+		);
+	}
+}
+
+void Log::level(Level l) {
+	if (l > Off) {
+		std::lock_guard<std::mutex> lock(writer.block);
+		if (!writer.thread.joinable()) {
+			writer.thread = std::thread(&LogWriter::run, &writer);
+		}
+	}
+	verbosity = l;
+}
+
+const char *Log::name(Level l) {
+	return levelNames[l];
+}
+
+bool Log::parse(const std::string &str, Level &l) {
+	for (int i = Off; i <= Trace; ++i) {
+		if (str == levelNames[i]) {
+			l = (Level)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::uint64_t Log::dropped() {
+	return writer.dropped;
+}
+
+void Log::stop() {
+	writer.stop();
+}
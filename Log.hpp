@@ -0,0 +1,153 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/**
+ * Diagnostic logging that is cheap enough to leave enabled on the input
+ * path. A log call stores a fixed-size binary record: a time, a pointer to
+ * the format string, and up to six arguments. The records are formatted and
+ * written to stderr by a background thread, so the caller never formats text.
+ * The thread sleeps while there is nothing to write; the caller only makes a
+ * system call to wake it for the first record after the thread went idle.
+ *
+ * Format strings and string arguments must stay valid for the life of the
+ * program, such as string literals, because only their pointers are kept.
+ * The format accepts @c %%d for integers, @c %%x for integers in
+ * hexadecimal, @c %%s for strings, and @c %%%% for a percent sign.
+ *
+ * Records may only be made from the thread that reads the touchscreen. If
+ * the background thread falls behind, records are discarded and counted.
+ * @author  Jeff Jackowski
+ */
+class Log {
+public:
+	/**
+	 * Verbosity levels; each includes the ones before it.
+	 */
+	enum Level : std::uint8_t {
+		Off,
+		/**
+		 * Problems.
+		 */
+		Error,
+		/**
+		 * Infrequent notable events.
+		 */
+		Info,
+		/**
+		 * The translator's state after each frame.
+		 */
+		Debug,
+		/**
+		 * Each event read from the touchscreen.
+		 */
+		Trace
+	};
+	/**
+	 * The most arguments a record may have.
+	 */
+	static constexpr int maxArgs = 6;
+	/**
+	 * A log entry waiting to be formatted.
+	 */
+	struct Record {
+		std::int64_t time;
+		const char *format;
+		std::int64_t args[maxArgs];
+		Level level;
+	};
+private:
+	/**
+	 * The current verbosity.
+	 */
+	static std::atomic<Level> verbosity;
+	/**
+	 * Adds a record to the queue.
+	 */
+	static void push(const Record &r);
+	static std::int64_t arg(const char *s) {
+		return (std::int64_t)(std::intptr_t)s;
+	}
+	template <class T>
+	static std::int64_t arg(T t) {
+		static_assert(
+			std::is_integral<T>::value || std::is_enum<T>::value,
+			"Log arguments must be integers or strings"
+		);
+		return (std::int64_t)t;
+	}
+public:
+	/**
+	 * True if records of the given level are kept. Useful to avoid the cost
+	 * of finding the arguments.
+	 */
+	static bool enabled(Level l) {
+		return l <= verbosity.load(std::memory_order_relaxed);
+	}
+	/**
+	 * Changes the verbosity. The background thread is started the first time
+	 * logging is enabled.
+	 */
+	static void level(Level l);
+	static Level level() {
+		return verbosity.load(std::memory_order_relaxed);
+	}
+	/**
+	 * The name of a level, as used by parse().
+	 */
+	static const char *name(Level l);
+	/**
+	 * Finds a level by name.
+	 * @return  False if the name is unknown.
+	 */
+	static bool parse(const std::string &str, Level &l);
+	/**
+	 * The number of records that were discarded because the background
+	 * thread fell behind.
+	 */
+	static std::uint64_t dropped();
+	/**
+	 * Formats and writes out all queued records, then stops the background
+	 * thread.
+	 */
+	static void stop();
+	/**
+	 * Makes a log record if the level is enabled.
+	 * @param l     The record's level.
+	 * @param fmt   The format string. It must remain valid.
+	 * @param args  Integers or strings that remain valid.
+	 */
+	template <class... Args>
+	static void write(Level l, const char *fmt, Args... args) {
+		static_assert(sizeof...(Args) <= maxArgs, "Too many log arguments");
+		if (enabled(l)) {
+			Record r = {
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()
+				).count(),
+				fmt,
+				{ arg(args)... },
+				l
+			};
+			push(r);
+		}
+	}
+};
+
+#endif        //  #ifndef LOG_HPP
@@ -0,0 +1,22 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "MemorySink.hpp"
+
+MemorySink::MemorySink(std::size_t capacity) :
+events(capacity ? capacity : 1), written(0), frameCount(0) { }
+
+void MemorySink::write(const input_event *ev, int count) {
+	for (int i = 0; i < count; ++i, ++written) {
+		events[written % events.size()] = ev[i];
+	}
+	++frameCount;
+}
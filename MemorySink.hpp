@@ -0,0 +1,89 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef MEMORYSINK_HPP
+#define MEMORYSINK_HPP
+
+#include "OutputSink.hpp"
+#include <cstdint>
+#include <vector>
+
+/**
+ * Keeps output events in memory rather than sending them anywhere. The
+ * storage is allocated once by the constructor, and the oldest events are
+ * overwritten when it is full, so writing never makes a system call or
+ * allocates memory. Useful for measuring the cost of translation, and for
+ * running the translator where uinput is not available.
+ * @author  Jeff Jackowski
+ */
+class MemorySink : public OutputSink {
+	/**
+	 * The stored events.
+	 */
+	std::vector<input_event> events;
+	/**
+	 * The total number of events written; also locates the next event to
+	 * write.
+	 */
+	std::uint64_t written;
+	/**
+	 * The total number of frames written.
+	 */
+	std::uint64_t frameCount;
+public:
+	/**
+	 * @param capacity  The most events to keep.
+	 */
+	MemorySink(std::size_t capacity = 4096);
+	/**
+	 * Stores the events.
+	 */
+	virtual void write(const input_event *ev, int count);
+	/**
+	 * The number of events that are stored.
+	 */
+	std::size_t size() const {
+		return written < events.size() ? (std::size_t)written : events.size();
+	}
+	/**
+	 * The most events that can be stored.
+	 */
+	std::size_t capacity() const {
+		return events.size();
+	}
+	/**
+	 * A stored event.
+	 * @param i  The index; zero is the oldest stored event.
+	 */
+	const input_event &operator[](std::size_t i) const {
+		return events[(written - size() + i) % events.size()];
+	}
+	/**
+	 * The total number of events written, including overwritten events.
+	 */
+	std::uint64_t totalEvents() const {
+		return written;
+	}
+	/**
+	 * The total number of frames written.
+	 */
+	std::uint64_t totalFrames() const {
+		return frameCount;
+	}
+	/**
+	 * Discards the stored events and resets the counters.
+	 */
+	void clear() {
+		written = frameCount = 0;
+	}
+};
+
+#endif        //  #ifndef MEMORYSINK_HPP
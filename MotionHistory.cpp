@@ -0,0 +1,46 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "MotionHistory.hpp"
+
+bool MotionHistory::velocity(std::int64_t since, int &vx, int &vy) const {
+	if (count < 2) {
+		return false;
+	}
+	// sums relative to the latest sample keep the products small
+	const Sample &last = latest();
+	std::int64_t n = 0, st = 0, stt = 0, sx = 0, sy = 0, stx = 0, sty = 0;
+	for (int i = 0; i < count; ++i) {
+		const Sample &s = samples[(next - 1 - i) & (length - 1)];
+		if (s.time < since) {
+			// older samples are further back in the ring
+			break;
+		}
+		std::int64_t t = s.time - last.time;
+		std::int64_t x = s.x - last.x;
+		std::int64_t y = s.y - last.y;
+		++n;
+		st += t;
+		stt += t * t;
+		sx += x;
+		sy += y;
+		stx += t * x;
+		sty += t * y;
+	}
+	// the slope of the fitted line is the velocity
+	std::int64_t den = n * stt - st * st;
+	if ((n < 2) || !den) {
+		return false;
+	}
+	vx = (int)((n * stx - st * sx) * 1000000 / den);
+	vy = (int)((n * sty - st * sy) * 1000000 / den);
+	return true;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef MOTIONHISTORY_HPP
+#define MOTIONHISTORY_HPP
+
+#include <cstdint>
+
+/**
+ * The most recent locations of one contact and when they were reported, kept
+ * to estimate how fast the contact is moving. The samples are in a ring of
+ * fixed size so that adding one is a copy of 16 bytes, and the whole history
+ * of a contact spans two cache lines.
+ * @author  Jeff Jackowski
+ */
+class MotionHistory {
+public:
+	/**
+	 * The number of samples kept; a power of two.
+	 */
+	static constexpr int length = 8;
+	/**
+	 * A location and the time, in microseconds, that it was reported.
+	 */
+	struct Sample {
+		std::int64_t time;
+		std::int32_t x;
+		std::int32_t y;
+	};
+private:
+	Sample samples[length];
+	/**
+	 * The index where the next sample goes.
+	 */
+	std::uint8_t next;
+	/**
+	 * The number of samples kept.
+	 */
+	std::uint8_t count;
+public:
+	MotionHistory() : next(0), count(0) { }
+	/**
+	 * Forgets all samples; used when a new contact starts.
+	 */
+	void clear() {
+		next = count = 0;
+	}
+	/**
+	 * Adds a sample, replacing the oldest one if the ring is full.
+	 */
+	void add(std::int64_t time, int x, int y) {
+		samples[next] = Sample { time, x, y };
+		next = (next + 1) & (length - 1);
+		if (count < length) {
+			++count;
+		}
+	}
+	/**
+	 * True if there are no samples.
+	 */
+	bool empty() const {
+		return !count;
+	}
+	/**
+	 * The most recent sample.
+	 * @pre  The history is not empty.
+	 */
+	const Sample &latest() const {
+		return samples[(next - 1) & (length - 1)];
+	}
+	/**
+	 * Estimates the velocity with a least-squares fit of a line to the
+	 * samples that are no older than a given time. The samples used should
+	 * span no more than about a second to keep the sums within 64 bits.
+	 * @param since  The time of the oldest sample to use, in microseconds.
+	 * @param vx     The velocity along the X axis in units per second.
+	 * @param vy     The velocity along the Y axis in units per second.
+	 * @return       False if fewer than two samples at different times are
+	 *               recent enough; the velocity is not changed.
+	 */
+	bool velocity(std::int64_t since, int &vx, int &vy) const;
+};
+
+#endif        //  #ifndef MOTIONHISTORY_HPP
@@ -9,111 +9,546 @@
  *
  * Copyright (C) 2018  Jeff Jackowski
  */
-#include "MtTranslate.hpp"
-#include <iostream>
+#include "MtTranslateSlots.hpp"
+#include "FlightRecorder.hpp"
+#include "Log.hpp"
+#include "StatePublisher.hpp"
+#include "Trace.hpp"
+#include "UinputSink.hpp"
+#include <algorithm>
+#include <cmath>
 
-void MtTranslate::init() {
-	cur = slot = scnt = cntctCur = cntctOld = cursorX = cursorY = 0;
-	old = 1;
-	curOp = None;
-	eventtime = std::chrono::steady_clock::now();
-	// configure reception of mulit-touch input events
-	evdev->inputConnect(
-		EventTypeCode(EV_ABS, ABS_MT_SLOT),
-		std::bind(&MtTranslate::slotEvent, this, std::placeholders::_2)
-	);
-	evdev->inputConnect(
-		EventTypeCode(EV_ABS, ABS_MT_TRACKING_ID),
-		std::bind(&MtTranslate::trackEvent, this, std::placeholders::_2)
-	);
-	evdev->inputConnect(
-		EventTypeCode(EV_ABS, ABS_MT_POSITION_X),
-		std::bind(&MtTranslate::xPosEvent, this, std::placeholders::_2)
+/**
+ * Converts a time to nanoseconds for tracepoints.
+ */
+static inline std::int64_t traceTime(
+	std::chrono::steady_clock::time_point t
+) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		t.time_since_epoch()
+	).count();
+}
+
+/**
+ * Provides the given sink, or makes a uinput device if none is given.
+ */
+static OutputSinkPtr makeSink(
+	OutputSinkPtr &&s,
+	const Transform &xf,
+	const MtTranslate::Config &c
+) {
+	if (s) {
+		return std::move(s);
+	}
+	return OutputSinkPtr(new UinputSink(xf.xInfo(), xf.yInfo(), c.keys()));
+}
+
+std::vector<std::uint16_t> MtTranslate::Config::keys() const {
+	std::vector<std::uint16_t> k;
+	auto add = [&k](const Chord &c) {
+		for (int i = 0; i < c.size(); ++i) {
+			k.push_back(c.key(i));
+		}
+	};
+	for (const Region &r : regions) {
+		if (r.action == Region::Key) {
+			add(r.chord);
+		}
+	}
+	for (const Chord &c : bindings) {
+		add(c);
+	}
+	std::sort(k.begin(), k.end());
+	k.erase(std::unique(k.begin(), k.end()), k.end());
+	return k;
+}
+
+MtTranslate::MtTranslate(
+	const EvdevShared &ev,
+	const Transform &xf,
+	const Config &c,
+	OutputSinkPtr &&s
+) :
+evdev(ev), xform(xf), eo(makeSink(std::move(s), xform, c)),
+scrollVert(REL_WHEEL_HI_RES, REL_WHEEL),
+scrollHoriz(REL_HWHEEL_HI_RES, REL_HWHEEL),
+zoom(REL_WHEEL_HI_RES, REL_WHEEL),
+spin(REL_HWHEEL_HI_RES, REL_HWHEEL), cfg(c) {
+	scnt = cntctCur = cntctOld = cursorX = cursorY = 0;
+	centX = centY = anchorX = anchorY = 0;
+	sumX = sumY = sumSq = spread = 0;
+	pairX = pairY = pairOldX = pairOldY = 0;
+	pairDist = pinchTotal = twistTotal = 0;
+	pairNew = false;
+	liftVelX = liftVelY = 0;
+	active = activeOld = rejected = fresh = dirty = 0;
+	skipped = 0;
+	rejects = RejectStats();
+	publisher = nullptr;
+	edgeRegion = -1;
+	regionMap.build(
+		cfg.regions,
+		*evdev->absInfo(ABS_MT_POSITION_X),
+		*evdev->absInfo(ABS_MT_POSITION_Y),
+		xform
 	);
-	evdev->inputConnect(
-		EventTypeCode(EV_ABS, ABS_MT_POSITION_Y),
-		std::bind(&MtTranslate::yPosEvent, this, std::placeholders::_2)
+	slot = -1;
+	curOp = None;
+	havePending = midFrame = tapped = abandoned = false;
+	tapWindow.configure(cfg.tapPercentile, cfg.tapMin, cfg.tapMax);
+	hasPressure = evdev->hasEventCode(EV_ABS, ABS_MT_PRESSURE);
+	scrollTime = eventtime = std::chrono::steady_clock::now();
+	kineticTimer = std::make_shared<Timer>(
+		std::bind(&MtTranslate::kineticHandle, this)
 	);
-	evdev->inputConnect(
-		EventTypeCode(EV_SYN, SYN_REPORT),
-		std::bind(&MtTranslate::synEvent, this)
+}
+
+std::unique_ptr<MtTranslate> MtTranslate::make(
+	const EvdevShared &ev,
+	const Transform &xf,
+	const Config &c,
+	OutputSinkPtr &&s
+) {
+	int n = ev->numSlots();
+	if (n <= 2) {
+		return std::unique_ptr<MtTranslate>(
+			new MtTranslateSlots<2>(ev, xf, c, std::move(s))
+		);
+	} else if (n <= 5) {
+		return std::unique_ptr<MtTranslate>(
+			new MtTranslateSlots<5>(ev, xf, c, std::move(s))
+		);
+	} else if (n <= 10) {
+		return std::unique_ptr<MtTranslate>(
+			new MtTranslateSlots<10>(ev, xf, c, std::move(s))
+		);
+	}
+	return std::unique_ptr<MtTranslate>(
+		new MtTranslateSlots<0>(ev, xf, c, std::move(s))
 	);
 }
 
-MtTranslate::MtTranslate(const EvdevShared &ev, int movethres) :
-evdev(ev), eo(*evdev), slots(evdev->numSlots()), moveDist(movethres) {
-	init();
+MtTranslate::~MtTranslate() {
+	// the connections to evdev are undone by conns
+	kineticTimer->stop();
+	kineticTimer->removeFromPoller();
+	// do not leave a button held down on the output device
+	try {
+		releaseButtons();
+	} catch (...) { }
+	if (publisher) {
+		publisher->clear();
+	}
 }
 
-MtTranslate::MtTranslate(EvdevShared &&ev, int movethres) :
-evdev(std::move(ev)), eo(*evdev), slots(evdev->numSlots()), moveDist(movethres) {
-	init();
+void MtTranslate::usePoller(Poller &p) {
+	kineticTimer->usePoller(p);
+	eo.usePoller(p);
 }
 
-MtTranslate::~MtTranslate() {
-	// should disconnect from evdev; not yet supported
+void MtTranslate::publishTo(StatePublisher *sp) {
+	if (publisher) {
+		publisher->clear();
+	}
+	publisher = sp;
+	if (publisher) {
+		TouchFrame &f = publisher->begin();
+		f.minX = xform.xInfo().minimum;
+		f.maxX = xform.xInfo().maximum;
+		f.minY = xform.yInfo().minimum;
+		f.maxY = xform.yInfo().maximum;
+		publisher->end();
+	}
 }
 
-void MtTranslate::slotEvent(std::int32_t val) {
-	slot = val;
+void MtTranslate::releaseButtons() {
+	if ((curOp >= DragLeft) && (curOp <= DragMiddle)) {
+		eo.set(EventTypeCode(EV_KEY, cfg.buttons[curOp - DragLeft]), 0);
+		eo.sync();
+		curOp = None;
+	} else if ((curOp == Pinch) || (curOp == Rotate)) {
+		eo.set(EventTypeCode(EV_KEY, KEY_LEFTCTRL), 0);
+		eo.sync();
+		curOp = None;
+	} else if (curOp == Pressed) {
+		eo.set(EventTypeCode(EV_KEY, BTN_LEFT), 0);
+		eo.sync();
+		curOp = None;
+	}
 }
 
-void MtTranslate::trackEvent(std::int32_t val) {
-	slots[slot][cur].tid = val;
-	if (val < 0) {
-		--scnt;
+void MtTranslate::configure(const Config &c) {
+	if (midFrame) {
+		// finish the frame with the old settings
+		pendingCfg = c;
+		havePending = true;
 	} else {
-		++scnt;
+		apply(c);
 	}
-	//std::cout << "trackEvent: id = " << val << "  slots = " << scnt << std::endl;
-	assert((scnt >= 0) && (scnt <= slots.size()));
 }
 
-void MtTranslate::xPosEvent(std::int32_t val) {
-	slots[slot][cur].x = val;
+void MtTranslate::apply(const Config &c) {
+	havePending = false;
+	// a held button must be released with the button that was pressed
+	if (c.paused || (c.buttons[0] != cfg.buttons[0]) ||
+	(c.buttons[1] != cfg.buttons[1]) || (c.buttons[2] != cfg.buttons[2]) ||
+	((curOp == Pinch) && !c.pinchDist) || ((curOp == Rotate) && !c.twist)) {
+		releaseButtons();
+	}
+	if (c.paused || !c.kinetic) {
+		stopKinetic();
+	}
+	if (!c.holdTime) {
+		deadlines.cancel(HoldDeadline);
+	}
+	if (c.paused) {
+		deadlines.cancel(TapDeadline);
+		deadlines.cancel(HoldDeadline);
+		curOp = None;
+		tapped = false;
+	} else if (cfg.paused) {
+		// resume as though all contacts just started
+		activeOld = 0;
+		cntctOld = 0;
+		curOp = None;
+	}
+	bool remap = !(c.regions == cfg.regions);
+	cfg = c;
+	tapWindow.configure(cfg.tapPercentile, cfg.tapMin, cfg.tapMax);
+	// a gesture in progress keeps the operation from its starting region
+	if (remap) {
+		regionMap.build(
+			cfg.regions,
+			*evdev->absInfo(ABS_MT_POSITION_X),
+			*evdev->absInfo(ABS_MT_POSITION_Y),
+			xform
+		);
+	}
 }
 
-void MtTranslate::yPosEvent(std::int32_t val) {
-	slots[slot][cur].y = val;
+const char *MtTranslate::operationName() const {
+	static const char *opstr[Edge+1] = {
+		"None",
+		"RelLeft",
+		"RelRight",
+		"RelMiddle",
+		"DragLeft",
+		"DragRight",
+		"DragMiddle",
+		"MoveCursor",
+		"ScrollVert",
+		"ScrollHoriz",
+		"Scroll2D",
+		"Pinch",
+		"Rotate",
+		"Held",
+		"Ignored",
+		"Pressed",
+		"Edge"
+	};
+	return opstr[curOp];
 }
 
-void MtTranslate::synEvent() {
-	timepoint currtime = std::chrono::steady_clock::now();
-	bool updateCursor = false;
+static const char *gesturestr[MtTranslate::GestureCount] = {
+	"tap4",
+	"tap5",
+	"swipe3up",
+	"swipe3down",
+	"swipe3left",
+	"swipe3right",
+	"swipe4up",
+	"swipe4down",
+	"swipe4left",
+	"swipe4right",
+	"flickup",
+	"flickdown",
+	"flickleft",
+	"flickright"
+};
+
+const char *MtTranslate::gestureName(int g) {
+	return gesturestr[g];
+}
 
+int MtTranslate::gestureNamed(const std::string &name) {
+	for (int g = 0; g < GestureCount; ++g) {
+		if (name == gesturestr[g]) {
+			return g;
+		}
+	}
+	return -1;
+}
+
+int MtTranslate::scroll(ScrollAxis &sa, int pixels) {
+	// 120 high-resolution units per scrollDist pixels; keep the remainder
+	// so that slow motion eventually scrolls
+	sa.rem += pixels * 120;
+	int hires = sa.rem / cfg.scrollDist;
+	sa.rem -= hires * cfg.scrollDist;
+	if (hires) {
+		wheel(sa, hires);
+	}
+	return hires;
+}
+
+void MtTranslate::wheel(ScrollAxis &sa, int hires) {
+	eo.set(EventTypeCode(EV_REL, sa.hiresCode), hires);
+	// legacy wheel events for programs that do not use high-resolution
+	// scrolling; a change in direction starts a new detent
+	if ((sa.wheel ^ hires) < 0) {
+		sa.wheel = 0;
+	}
+	sa.wheel += hires;
+	int detents = sa.wheel / 120;
+	if (detents) {
+		sa.wheel -= detents * 120;
+		eo.set(EventTypeCode(EV_REL, sa.code), detents);
+	}
+}
+
+int MtTranslate::pinchWheel(int change) {
+	// 120 high-resolution units per pinchDist pixels; spreading the contacts
+	// apart zooms in, which is wheel motion away from the user
+	zoom.rem += change * 120;
+	int hires = zoom.rem / (cfg.pinchDist << pairFrac);
+	zoom.rem -= hires * (cfg.pinchDist << pairFrac);
+	if (hires) {
+		wheel(zoom, hires);
+	}
+	return hires;
+}
+
+int MtTranslate::rotateWheel(int turn) {
+	// 120 high-resolution units per 15 degrees; clockwise is to the right
+	spin.rem += turn * 120;
+	int hires = spin.rem / twistDetent;
+	spin.rem -= hires * twistDetent;
+	if (hires) {
+		wheel(spin, hires);
+	}
+	return hires;
+}
+
+void MtTranslate::startKinetic(timepoint currtime) {
+	if (
+		cfg.kinetic &&
+		// contacts still moving when lifted?
+		(currtime - scrollTime <= kineticHold) &&
+		(
+			(std::abs(scrollVert.vel) >= kineticMinVel) ||
+			(std::abs(scrollHoriz.vel) >= kineticMinVel)
+		)
+	) {
+		scrollVert.kinRem = scrollHoriz.kinRem = 0;
+		kineticTimer->start(kineticTick, kineticTick);
+	}
+}
+
+void MtTranslate::stopKinetic() {
+	kineticTimer->stop();
+	scrollVert.vel = scrollHoriz.vel = 0;
+}
+
+void MtTranslate::kineticHandle() {
+	bool sync = false;
+	FlightRecorder::now(std::chrono::steady_clock::now());
+	for (ScrollAxis *sa : { &scrollVert, &scrollHoriz }) {
+		if (std::abs(sa->vel) < kineticMinVel) {
+			sa->vel = 0;
+			continue;
+		}
+		sa->kinRem += sa->vel * kineticTick.count();
+		int hires = sa->kinRem / 1000;
+		sa->kinRem -= hires * 1000;
+		if (hires) {
+			wheel(*sa, hires);
+			sync = true;
+		}
+		// decay velocity; about 6% per tick
+		sa->vel -= sa->vel / 16;
+	}
+	if (sync) {
+		eo.sync();
+	}
+	if (!scrollVert.vel && !scrollHoriz.vel) {
+		kineticTimer->stop();
+	}
+}
+
+void MtTranslate::sumSlot(const SlotState &ss, int sign) {
+	sumX += sign * ss.x;
+	sumY += sign * ss.y;
+	sumSq += sign * ((std::int64_t)ss.x * ss.x + (std::int64_t)ss.y * ss.y);
+}
+
+void MtTranslate::pairFrame(const SlotState &a, const SlotState &b) {
+	int ax = a.x, ay = a.y, bx = b.x, by = b.y;
+	xform.apply(ax, ay);
+	xform.apply(bx, by);
+	pairX = bx - ax;
+	pairY = by - ay;
+	pairNew = true;
+}
+
+void MtTranslate::pairMotion(int &pinch, int &turn) {
+	const std::int64_t minDist = std::int64_t(1) << pairFrac;
+	// squared distance, scaled to match the fixed-point distance squared
+	std::int64_t sq = ((std::int64_t)pairX * pairX +
+		(std::int64_t)pairY * pairY) << (2 * pairFrac);
+	if (!pairDist || (active != activeOld)) {
+		// a new pair of contacts; the only square root taken for the pair
+		pairDist = std::max((std::int64_t)std::sqrt((double)sq), minDist);
+		pinchTotal = twistTotal = 0;
+	} else {
+		// the distance changes little between frames, so one step of
+		// Newton's method from the last distance is enough to track it
+		std::int64_t dist = std::max((pairDist + sq / pairDist) / 2, minDist);
+		pinch = (int)(dist - pairDist);
+		pairDist = dist;
+		pinchTotal += pinch;
+		// the angle between the old and new vectors is about the ratio of
+		// their cross and dot products when small; larger changes between
+		// frames, like contacts swapping places, are ignored
+		std::int64_t dot = (std::int64_t)pairOldX * pairX +
+			(std::int64_t)pairOldY * pairY;
+		if (dot > 0) {
+			std::int64_t cross = (std::int64_t)pairOldX * pairY -
+				(std::int64_t)pairOldY * pairX;
+			turn = (int)((cross << twistFrac) / dot);
+			twistTotal += turn;
+		}
+	}
+	pairOldX = pairX;
+	pairOldY = pairY;
+}
+
+void MtTranslate::synEvent(timepoint currtime) {
+	bool updateCursor = false;
+	// a gesture sent after the cursor reaches the end of its motion
+	int flicked = -1;
+	int prevOp = curOp;
+	bool pair = pairNew;
+	pairNew = false;
+	scnt = __builtin_popcountll(active);
+	// the region where a new gesture starts, if any
+	int region = -1;
+	if (abandoned) {
+		// the lift of the rejected contact must not end the gesture as a
+		// tap, and a long press must not follow
+		abandoned = false;
+		releaseButtons();
+		deadlines.cancel(TapDeadline);
+		deadlines.cancel(HoldDeadline);
+		curOp = Ignored;
+	}
+	if (cfg.paused) {
+		// keep tracking contacts, but do nothing with them
+		TRACE_PROBE4(frame, traceTime(currtime), scnt, curOp, active);
+		midFrame = false;
+		if (havePending) {
+			apply(pendingCfg);
+		}
+		return;
+	}
+	if (scnt) {
+		int x = sumX / scnt;
+		int y = sumY / scnt;
+		// spread is in touchscreen coordinates
+		spread = sumSq / scnt - ((std::int64_t)x * x + (std::int64_t)y * y);
+		if (!activeOld && !regionMap.empty()) {
+			int r = regionMap.find(x, y);
+			if ((r >= 0) && (cfg.regions[r].action != Region::Gestures)) {
+				region = r;
+			}
+		}
+		xform.apply(x, y);
+		if (active == activeOld) {
+			// anchor follows the centroid's motion
+			anchorX += x - centX;
+			anchorY += y - centY;
+		} else if (
+			!activeOld || (
+				// new contacts ...
+				(active & ~activeOld) && (
+					// ... before any operation started
+					(curOp == None) || (
+						// ... or before a drag has moved
+						(curOp >= DragLeft) && (curOp <= DragMiddle) &&
+						(anchorX == cursorX) && (anchorY == cursorY)
+					)
+				)
+			)
+		) {
+			// the gesture starts from the new centroid
+			anchorX = x;
+			anchorY = y;
+			if (activeOld && (curOp == None)) {
+				cursorX = x;
+				cursorY = y;
+			}
+		}
+		// otherwise, contacts were added or removed during an operation;
+		// keep the anchor where it is so the cursor does not jump
+		centX = x;
+		centY = y;
+	}
+	// distance and angle between two contacts for pinch and rotate
+	int pinch = 0, turn = 0;
+	if (pair) {
+		pairMotion(pinch, turn);
+	} else {
+		pairDist = 0;
+	}
 	cntctCur = scnt;
 	// start contact
 	if (!cntctOld && cntctCur) {
+		// how soon the user touches again after a tap sets the tap window
+		if (tapped) {
+			tapWindow.retouch(currtime - eventtime);
+			tapped = false;
+		}
+		// a new touch stops any kinetic scrolling
+		if (kineticTimer->active()) {
+			stopKinetic();
+		}
+		if (region >= 0) {
+			// a tap waiting for another touch will not become a drag
+			if (curOp && (curOp <= ReleaseMiddle)) {
+				deadlines.cancel(TapDeadline);
+				tapTimeout(currtime);
+			}
+			eventtime = currtime;
+			cursorX = anchorX;
+			cursorY = anchorY;
+			regionStart(region);
+		}
 		// previous contact not long ago?
-		if (curOp && (curOp <= ReleaseMiddle)) {
+		else if (curOp && (curOp <= ReleaseMiddle)) {
 			duration span = currtime - eventtime;
-			if (span <= tapTime) {
+			if (span <= tapWindow.window()) {
 				// transition to drag operation & press button
-				switch (curOp) {
-					case ReleaseLeft:
-						curOp = DragLeft;
-						eo.set(EventTypeCode(EV_KEY, BTN_LEFT), 1);
-						break;
-					case ReleaseRight:
-						curOp = DragRight;
-						eo.set(EventTypeCode(EV_KEY, BTN_RIGHT), 1);
-						break;
-					case ReleaseMiddle:
-						curOp = DragMiddle;
-						eo.set(EventTypeCode(EV_KEY, BTN_MIDDLE), 1);
-						break;
-				}
+				eo.set(
+					EventTypeCode(EV_KEY, cfg.buttons[curOp - ReleaseLeft]),
+					1
+				);
+				curOp += DragLeft - ReleaseLeft;
+				deadlines.cancel(TapDeadline);
 				updateCursor = true;
 			}
 		} else {
 			// do not respond to a release condition; time has expired
 			curOp = None;
 			eventtime = currtime;
-			// should always be the first slot
-			assert(slots[0][cur].tid >= 0);
 			// store contact position as cursor, but do not update cursor
-			cursorX = slots[0][cur].x;
-			cursorY = slots[0][cur].y;
+			cursorX = anchorX;
+			cursorY = anchorY;
+			// a single contact that stays put becomes a long press
+			if (cfg.holdTime && (cntctCur == 1)) {
+				deadlines.schedule(
+					HoldDeadline,
+					currtime + std::chrono::milliseconds(cfg.holdTime)
+				);
+			}
 		}
 	}
 	// end contact
@@ -124,21 +559,71 @@ void MtTranslate::synEvent() {
 		}
 		switch (curOp) {
 			case None:
-				// change operation to release
-				curOp = ReleaseLeft - 1 + cntctOld;
-				eventtime = currtime;
+				if (cntctOld <= 3) {
+					// change operation to release
+					curOp = ReleaseLeft - 1 + cntctOld;
+					eventtime = currtime;
+					tapped = true;
+					deadlines.schedule(
+						TapDeadline,
+						currtime + tapWindow.window()
+					);
+				} else if (cntctOld <= 5) {
+					// taps with more contacts only send keys, if bound
+					const Chord &c = cfg.bindings[Tap4 + cntctOld - 4];
+					if (!c.empty()) {
+						eo.send(c.frame());
+					}
+				}
 				break;
 			case DragLeft:
+			case DragRight:
+			case DragMiddle:
+				eo.set(
+					EventTypeCode(EV_KEY, cfg.buttons[curOp - DragLeft]),
+					0
+				);
 				curOp = None;
-				eo.set(EventTypeCode(EV_KEY, BTN_LEFT), 0);
 				break;
-			case DragRight:
+			case MoveCursor:
+				if (cntctOld == 1) {
+					flicked = flick();
+				}
+				break;
+			case ScrollVert:
+			case ScrollHoriz:
+			case Scroll2D:
+				// the velocity fitted to the motion before the lift is
+				// steadier than the one from the last few frames
+				if (liftVelX || liftVelY) {
+					if (curOp != ScrollHoriz) {
+						scrollVert.vel = (int)(
+							(std::int64_t)liftVelY * 120 / cfg.scrollDist
+						);
+					}
+					if (curOp != ScrollVert) {
+						scrollHoriz.vel = -(int)(
+							(std::int64_t)liftVelX * 120 / cfg.scrollDist
+						);
+					}
+				}
+				startKinetic(currtime);
+				break;
+			case Pinch:
+			case Rotate:
+				eo.set(EventTypeCode(EV_KEY, KEY_LEFTCTRL), 0);
+				eo.sync();
 				curOp = None;
-				eo.set(EventTypeCode(EV_KEY, BTN_RIGHT), 0);
 				break;
-			case DragMiddle:
+			case Pressed:
+				eo.set(EventTypeCode(EV_KEY, BTN_LEFT), 0);
+				eo.sync();
+				curOp = None;
+				break;
+			case Held:
+			case Ignored:
+			case Edge:
 				curOp = None;
-				eo.set(EventTypeCode(EV_KEY, BTN_MIDDLE), 0);
 				break;
 		}
 		cntctOld = 0;
@@ -156,9 +641,34 @@ void MtTranslate::synEvent() {
 		// start cursor motion?
 		if (curOp == None) {
 			// look for a change
-			int deltaX = std::abs(slots[0][cur].x - cursorX);
-			int deltaY = std::abs(slots[0][cur].y - cursorY);
-			if ((deltaX > moveDist) || (deltaY > moveDist)) {
+			int deltaX = std::abs(anchorX - cursorX);
+			int deltaY = std::abs(anchorY - cursorY);
+			// motion of two contacts relative to each other, in pixels
+			int spreading = 0, turning = 0;
+			if ((cntctCur == 2) && pairDist) {
+				if (cfg.pinchDist) {
+					spreading = (int)(std::abs(pinchTotal) >> pairFrac);
+				}
+				if (cfg.twist) {
+					// arc length covered by one contact around the other
+					turning = (int)((std::abs(twistTotal) * pairDist) >>
+						(twistFrac + pairFrac));
+				}
+			}
+			int relative = std::max(spreading, turning);
+			// relative motion must exceed the motion common to both contacts;
+			// it must also exceed twice the move threshold since the noise
+			// from two contacts adds up
+			if (relative > std::max(deltaX, deltaY)) {
+				if (relative > 2 * cfg.moveDist) {
+					curOp = (spreading >= turning) ? Pinch : Rotate;
+					zoom.reset();
+					spin.reset();
+					// the key is reported ahead of the wheel motion
+					eo.set(EventTypeCode(EV_KEY, KEY_LEFTCTRL), 1);
+					eo.sync();
+				}
+			} else if ((deltaX > cfg.moveDist) || (deltaY > cfg.moveDist)) {
 				// request to move cursor?
 				if ((curOp == None) && (cntctCur == 1)) {
 					curOp = MoveCursor;
@@ -174,38 +684,91 @@ void MtTranslate::synEvent() {
 						curOp = ScrollHoriz;
 					}
 				}
+				// swipe with keys bound
+				else if (
+					((cntctCur == 3) || (cntctCur == 4)) &&
+					swipeBound(cntctCur)
+				) {
+					swipe(cntctCur, deltaX, deltaY);
+				}
 				// scroll 2D
 				else if (cntctCur == 3) {
 					curOp = Scroll2D;
 				}
 			}
 		}
+		// an edge swipe sends its key once the contacts move
+		else if (curOp == Edge) {
+			if (
+				(std::abs(anchorX - cursorX) > cfg.moveDist) ||
+				(std::abs(anchorY - cursorY) > cfg.moveDist)
+			) {
+				if (edgeRegion < (int)cfg.regions.size()) {
+					eo.send(cfg.regions[edgeRegion].chord.frame());
+				}
+				curOp = Ignored;
+			}
+		}
 		// current operation involves moving the cursor
 		if (
 			// operation requires moving the cursor
-			(curOp >= DragLeft) && (curOp <= MoveCursor) &&
+			(((curOp >= DragLeft) && (curOp <= MoveCursor)) ||
+			(curOp == Pressed)) &&
 			// position has changed
-			((cursorX != slots[0][cur].x) || (cursorY != slots[0][cur].y))
+			((cursorX != anchorX) || (cursorY != anchorY))
 		) {
 			updateCursor = true;
 		}
-		// vertical scroll operation
-		else if ((curOp == ScrollVert) || (curOp == Scroll2D)) {
-			// look for a change
-			int delta = (slots[0][cur].y - cursorY) >> 3;
-			if (delta) {
-				cursorY = slots[0][cur].y;
-				eo.set(EventTypeCode(EV_REL, REL_WHEEL), delta);
+		else if ((curOp >= ScrollVert) && (curOp <= Scroll2D)) {
+			int hiresY = 0, hiresX = 0;
+			// vertical scroll operation
+			if ((curOp == ScrollVert) || (curOp == Scroll2D)) {
+				// look for a change
+				int delta = anchorY - cursorY;
+				if (delta) {
+					cursorY = anchorY;
+					hiresY = scroll(scrollVert, delta);
+				}
+			}
+			// horizontal scroll operation
+			if ((curOp == ScrollHoriz) || (curOp == Scroll2D)) {
+				// look for a change
+				int delta = cursorX - anchorX;
+				if (delta) {
+					cursorX = anchorX;
+					hiresX = scroll(scrollHoriz, delta);
+				}
+			}
+			if (hiresY || hiresX) {
 				sync = true;
+				// estimate velocity for kinetic scrolling
+				std::int64_t us = std::chrono::duration_cast<
+					std::chrono::microseconds
+				>(currtime - scrollTime).count();
+				if (us > std::chrono::microseconds(kineticHold).count()) {
+					// motion stopped for a while; start a new estimate
+					scrollVert.vel = scrollHoriz.vel = 0;
+				} else {
+					if (us < 1000) {
+						us = 1000;
+					}
+					// average with the previous estimate to smooth out
+					// irregular frame timing
+					scrollVert.vel = (scrollVert.vel +
+						(int)(hiresY * 1000000LL / us)) / 2;
+					scrollHoriz.vel = (scrollHoriz.vel +
+						(int)(hiresX * 1000000LL / us)) / 2;
+				}
+				scrollTime = currtime;
 			}
 		}
-		// horizontal scroll operation
-		else if ((curOp == ScrollHoriz) || (curOp == Scroll2D)) {
-			// look for a change
-			int delta = (cursorX - slots[0][cur].x) >> 3;
-			if (delta) {
-				cursorX = slots[0][cur].x;
-				eo.set(EventTypeCode(EV_REL, REL_HWHEEL), delta);
+		// pinch and rotate only respond while there are two contacts
+		else if ((curOp == Pinch) && pinch) {
+			if (pinchWheel(pinch)) {
+				sync = true;
+			}
+		} else if ((curOp == Rotate) && turn) {
+			if (rotateWheel(turn)) {
 				sync = true;
 			}
 		}
@@ -216,91 +779,184 @@ void MtTranslate::synEvent() {
 	}
 
 	if (updateCursor) {
-		// always using slot 0 is easy, but will cause cursor to suddenly move
-		// on mulitple finger double-tap if fingers contact in different order
-		// the second time
-		cursorX = slots[0][cur].x;
-		cursorY = slots[0][cur].y;
+		cursorX = anchorX;
+		cursorY = anchorY;
 		eo.set(EventTypeCode(EV_ABS, ABS_X), cursorX);
 		eo.set(EventTypeCode(EV_ABS, ABS_Y), cursorY);
 		eo.sync();
 	}
+	if ((flicked >= 0) && !cfg.bindings[flicked].empty()) {
+		eo.send(cfg.bindings[flicked].frame());
+	}
 
+	// motion, another contact, or lifting the contact ends a long press
+	if (
+		deadlines.pending(HoldDeadline) &&
+		((curOp != None) || (cntctCur != 1))
+	) {
+		deadlines.cancel(HoldDeadline);
+	}
 	// advance current to old
 	cntctOld = cntctCur;
-	//logstate();
+	activeOld = active;
+	if (curOp != prevOp) {
+		TRACE_PROBE4(operation, traceTime(currtime), prevOp, curOp, scnt);
+		FlightRecorder::operation(prevOp, curOp);
+	}
+	TRACE_PROBE4(frame, traceTime(currtime), scnt, curOp, active);
+	midFrame = false;
+	// settings changed during the frame take effect for the next one
+	if (havePending) {
+		apply(pendingCfg);
+	}
+	logstate();
 }
 
-void MtTranslate::timeoutHandle() {
-	// check for waiting on user to touch again
-	if (curOp && (curOp <= ReleaseMiddle)) {
-		// time up?
-		timepoint currtime = std::chrono::steady_clock::now();
-		duration span = currtime - eventtime;
-		if (span >= tapTime) {
-			// re-send position in case another input device moved the cursor
+void MtTranslate::regionStart(int r) {
+	switch (cfg.regions[r].action) {
+		case Region::Ignore:
+			curOp = Ignored;
+			break;
+		case Region::Click:
+			curOp = Pressed;
 			eo.set(EventTypeCode(EV_ABS, ABS_X), cursorX);
 			eo.set(EventTypeCode(EV_ABS, ABS_Y), cursorY);
-			// press button
-			int button;
-			switch (curOp) {
-				case ReleaseLeft:
-					button = BTN_LEFT;
-					break;
-				case ReleaseRight:
-					button = BTN_RIGHT;
-					break;
-				case ReleaseMiddle:
-					button = BTN_MIDDLE;
-					break;
-			}
-			eo.set(EventTypeCode(EV_KEY, button), 1);
+			eo.set(EventTypeCode(EV_KEY, BTN_LEFT), 1);
 			eo.sync();
-			// release button
-			eo.set(EventTypeCode(EV_KEY, button), 0);
-			eo.sync();
-			// done with this operation
-			curOp = None;
-			
-			//std::cout << "Released" << std::endl;
-			//logstate();
+			break;
+		case Region::Key:
+			curOp = Edge;
+			edgeRegion = r;
+			break;
+		default:
+			break;
+	}
+}
+
+bool MtTranslate::swipeBound(int contacts) const {
+	int first = (contacts == 3) ? Swipe3Up : Swipe4Up;
+	for (int g = first; g <= first + 3; ++g) {
+		if (!cfg.bindings[g].empty()) {
+			return true;
 		}
 	}
+	return false;
 }
 
-void MtTranslate::logstate() const {
-	static const char *opstr[Scroll2D+1] = {
-		"None",
-		"RelLeft",
-		"RelRight",
-		"RelMiddle",
-		"DragLeft",
-		"DragRight",
-		"DragMiddle",
-		"MoveCursor",
-		"ScrollVert",
-		"ScrollHoriz",
-		"Scroll2D"
-	};
-	// prevously kept writing over the same line
-	std::cout /* << '\r' */ << std::setw(12) << opstr[curOp] << ' ' <<
-	std::setw(3) << cursorX << ", " << std::setw(3) << cursorY << "  " <<
-	std::setw(2) << cntctCur << "  ";// << std::endl; //"   ";
-	if (eo.get(EventTypeCode(EV_KEY, BTN_LEFT))) {
-		std::cout << 'L';
+void MtTranslate::swipe(int contacts, int deltaX, int deltaY) {
+	int g = (contacts == 3) ? Swipe3Up : Swipe4Up;
+	if (deltaY > deltaX) {
+		g += (anchorY < cursorY) ? 0 : 1;
 	} else {
-		std::cout << ' ';
+		g += (anchorX < cursorX) ? 2 : 3;
 	}
-	if (eo.get(EventTypeCode(EV_KEY, BTN_MIDDLE))) {
-		std::cout << 'M';
-	} else {
-		std::cout << ' ';
+	if (!cfg.bindings[g].empty()) {
+		eo.send(cfg.bindings[g].frame());
 	}
-	if (eo.get(EventTypeCode(EV_KEY, BTN_RIGHT))) {
-		std::cout << 'R';
-	} else {
-		std::cout << ' ';
+	curOp = Ignored;
+}
+
+int MtTranslate::flick() const {
+	int speedX = std::abs(liftVelX);
+	int speedY = std::abs(liftVelY);
+	if (!cfg.flickSpeed || (std::max(speedX, speedY) < cfg.flickSpeed)) {
+		return -1;
+	}
+	if (speedY >= speedX) {
+		return (liftVelY < 0) ? FlickUp : FlickDown;
 	}
-	std::cout << "   " << std::endl;
-	//std::cout.flush();
+	return (liftVelX < 0) ? FlickLeft : FlickRight;
+}
+
+void MtTranslate::saveState(Snapshot &s) {
+	releaseButtons();
+	stopKinetic();
+	deadlines.cancel(TapDeadline);
+	deadlines.cancel(HoldDeadline);
+	curOp = None;
+	s.cursorX = cursorX;
+	s.cursorY = cursorY;
+	s.slot = slot;
+}
+
+void MtTranslate::restoreState(const Snapshot &s) {
+	slot = s.slot;
+	scnt = cntctCur = cntctOld = __builtin_popcountll(active);
+	activeOld = active;
+	cursorX = anchorX = s.cursorX;
+	cursorY = anchorY = s.cursorY;
+	if (scnt) {
+		int x = sumX / scnt;
+		int y = sumY / scnt;
+		xform.apply(x, y);
+		centX = x;
+		centY = y;
+	}
+	// the contacts continue as though just touched; the anchor follows
+	// their motion from the cursor
+	eventtime = std::chrono::steady_clock::now();
+}
+
+void MtTranslate::timeoutHandle() {
+	if (deadlines.empty()) {
+		return;
+	}
+	timepoint currtime = std::chrono::steady_clock::now();
+	deadlines.expire(currtime, [this, currtime](int id) {
+		if (id == TapDeadline) {
+			tapTimeout(currtime);
+		} else if (id == HoldDeadline) {
+			holdTimeout(currtime);
+		}
+	});
+}
+
+void MtTranslate::tapTimeout(timepoint currtime) {
+	// check for waiting on user to touch again
+	if (!cfg.paused && curOp && (curOp <= ReleaseMiddle)) {
+		FlightRecorder::now(currtime);
+		// re-send position in case another input device moved the cursor
+		eo.set(EventTypeCode(EV_ABS, ABS_X), cursorX);
+		eo.set(EventTypeCode(EV_ABS, ABS_Y), cursorY);
+		// press button
+		int button = cfg.buttons[curOp - ReleaseLeft];
+		eo.set(EventTypeCode(EV_KEY, button), 1);
+		eo.sync();
+		// release button
+		eo.set(EventTypeCode(EV_KEY, button), 0);
+		eo.sync();
+		// done with this operation
+		TRACE_PROBE4(operation, traceTime(currtime), curOp, None, scnt);
+		FlightRecorder::operation(curOp, None);
+		curOp = None;
+		logstate();
+	}
+}
+
+void MtTranslate::holdTimeout(timepoint currtime) {
+	// still one contact that has not moved?
+	if (!cfg.paused && (curOp == None) && (scnt == 1) && (cntctCur == 1)) {
+		FlightRecorder::now(currtime);
+		eo.set(EventTypeCode(EV_ABS, ABS_X), cursorX);
+		eo.set(EventTypeCode(EV_ABS, ABS_Y), cursorY);
+		eo.set(EventTypeCode(EV_KEY, cfg.holdButton), 1);
+		eo.sync();
+		eo.set(EventTypeCode(EV_KEY, cfg.holdButton), 0);
+		eo.sync();
+		// ignore the contact until it ends
+		TRACE_PROBE4(operation, traceTime(currtime), curOp, Held, scnt);
+		FlightRecorder::operation(curOp, Held);
+		curOp = Held;
+		logstate();
+	}
+}
+
+void MtTranslate::logstate() const {
+	Log::write(Log::Debug, "%s cursor %d, %d  contacts %d  spread %d  buttons %x",
+		operationName(), cursorX, cursorY, cntctCur, spread,
+		// one bit per button: left, middle, right
+		eo.get(EventTypeCode(EV_KEY, BTN_LEFT)) |
+		(eo.get(EventTypeCode(EV_KEY, BTN_MIDDLE)) << 1) |
+		(eo.get(EventTypeCode(EV_KEY, BTN_RIGHT)) << 2)
+	);
 }
@@ -9,14 +9,27 @@
  *
  * Copyright (C) 2018  Jeff Jackowski
  */
+#ifndef MTTRANSLATE_HPP
+#define MTTRANSLATE_HPP
+
+#include "Deadlines.hpp"
 #include "EvdevOutput.hpp"
+#include "RegionMap.hpp"
+#include "TapWindow.hpp"
+#include "Timer.hpp"
+#include "Transform.hpp"
 #include <chrono>
 
+class StatePublisher;
+
 /**
- * Multi-touch translator.
+ * Multi-touch translator. The state of each contact is kept by a subclass,
+ * MtTranslateSlots, that is specialized for the number of slots; use make()
+ * to get one suited to the touchscreen.
  * @author  Jeff Jackowski
  */
 class MtTranslate {
+protected:
 	/**
 	 * Much less useful than anticipated, but may be more useful if the
 	 * locations of each spot matter in a future operation.
@@ -28,24 +41,105 @@ class MtTranslate {
 		int tid;
 		int x;
 		int y;
-		SlotState() : tid(-1) { }
+		/**
+		 * Length of the major axis of the contact, if reported.
+		 */
+		int major;
+		/**
+		 * Length of the minor axis of the contact, if reported.
+		 */
+		int minor;
+		/**
+		 * Contact pressure, if reported.
+		 */
+		int pressure;
+		SlotState() : tid(-1), x(0), y(0), major(0), minor(0), pressure(0) { }
+	};
+	/**
+	 * Scroll state for one axis. Motion is reported in high-resolution wheel
+	 * units where 120 units make one detent of a traditional wheel.
+	 */
+	struct ScrollAxis {
+		/**
+		 * Contact motion that has not yet amounted to a high-resolution unit.
+		 * Stored in units of 1/scrollDist of a high-resolution unit.
+		 */
+		int rem;
+		/**
+		 * High-resolution units that have not yet amounted to a full detent
+		 * on the legacy wheel axis.
+		 */
+		int wheel;
+		/**
+		 * Estimated scroll velocity in high-resolution units per second.
+		 */
+		int vel;
+		/**
+		 * Kinetic motion that has not yet amounted to a high-resolution unit,
+		 * in thousandths of a unit.
+		 */
+		int kinRem;
+		/**
+		 * The high-resolution event code for the axis.
+		 */
+		std::uint16_t hiresCode;
+		/**
+		 * The legacy event code for the axis.
+		 */
+		std::uint16_t code;
+		ScrollAxis(std::uint16_t hc, std::uint16_t c) :
+		rem(0), wheel(0), vel(0), kinRem(0), hiresCode(hc), code(c) { }
+		void reset() {
+			rem = wheel = vel = kinRem = 0;
+		}
 	};
-	typedef SlotState StateHist[2];
 	/**
 	 * The touchscreen input device.
 	 */
 	EvdevShared evdev;
 	/**
-	 * The user-input device to which the translated input events are output.
+	 * Connections to the input signals of @a evdev; disconnected when this
+	 * object is destroyed.
 	 */
-	EvdevOutput eo;
+	std::vector<boost::signals2::scoped_connection> conns;
 	/**
-	 * Data on each of the "slots", stateful contact points reported by
-	 * multi-touch protocol B.
+	 * Maps contact locations to output locations. Applied to the centroid
+	 * once per frame; since the transformation is affine, this is the same as
+	 * transforming each contact and then finding their centroid.
 	 */
-	std::vector<StateHist> slots;
+	Transform xform;
+	/**
+	 * The user-input device to which the translated input events are output.
+	 */
+	EvdevOutput eo;
 	typedef std::chrono::steady_clock::time_point  timepoint;
 	typedef std::chrono::steady_clock::duration  duration;
+	/**
+	 * Vertical scroll state.
+	 */
+	ScrollAxis scrollVert;
+	/**
+	 * Horizontal scroll state.
+	 */
+	ScrollAxis scrollHoriz;
+	/**
+	 * Wheel state for pinch zooming.
+	 */
+	ScrollAxis zoom;
+	/**
+	 * Wheel state for rotation.
+	 */
+	ScrollAxis spin;
+	/**
+	 * Drives kinetic scrolling after the contacts are lifted. It is only
+	 * running while there is momentum to report.
+	 */
+	TimerShared kineticTimer;
+	/**
+	 * The time of the last frame that included scroll motion. Used for the
+	 * velocity estimate.
+	 */
+	timepoint scrollTime;
 	/**
 	 * The time when some event occured that may need to be referenced later.
 	 * For instance, if the user taps the screen, the time is used in case the
@@ -53,21 +147,404 @@ class MtTranslate {
 	 */
 	timepoint eventtime;
 	/**
-	 * Index of the most current touch information in the StateHist arrays.
+	 * Times when pending gestures are resolved if no input arrives first.
+	 */
+	Deadlines deadlines;
+	/**
+	 * Identifiers for the deadlines in @a deadlines.
+	 */
+	enum Deadline {
+		/**
+		 * A tap becomes a click if the screen is not touched again.
+		 */
+		TapDeadline,
+		/**
+		 * A single contact that has not moved becomes a long press.
+		 */
+		HoldDeadline
+	};
+	/**
+	 * Finds the screen region where each gesture starts.
 	 */
-	int cur;
+	RegionMap regionMap;
 	/**
-	 * Index of the old touch information in the StateHist arrays.
+	 * The index of the region whose chord is sent once the contacts move
+	 * during the Edge operation.
 	 */
-	int old;
+	int edgeRegion;
 	/**
 	 * The currently updating slot from the multi-touch input, protocol B.
 	 */
 	int slot;
 	/**
 	 * The number of slots in use, which is the number of contact points.
+	 * Computed from @a active at the start of synEvent().
 	 */
 	int scnt;
+	/**
+	 * A bit mask of the slots that currently have a contact.
+	 */
+	typedef std::uint64_t  SlotMask;
+	/**
+	 * The most slots that will be tracked; limited by the size of SlotMask.
+	 */
+	static constexpr int maxSlots = 64;
+	/**
+	 * The slots with a contact, updated as tracking IDs arrive.
+	 */
+	SlotMask active;
+	/**
+	 * The value of @a active at the end of the last synEvent().
+	 */
+	SlotMask activeOld;
+	/**
+	 * Slots with contacts that were rejected as palms or ghosts. They are
+	 * not in @a active, and remain rejected until the contact ends.
+	 */
+	SlotMask rejected;
+	/**
+	 * True when a contact that was already part of the gesture, like a
+	 * palm that grew, is rejected. synEvent() then ends the gesture without
+	 * a tap and ignores the remaining contacts.
+	 */
+	bool abandoned;
+	/**
+	 * Slots with contacts that started in the current frame. Checked for
+	 * rejection in synEvent().
+	 */
+	SlotMask fresh;
+	/**
+	 * Slots whose contact started, ended, or moved in the current frame.
+	 * A frame without any is not given to synEvent().
+	 */
+	SlotMask dirty;
+	/**
+	 * The number of frames that changed no contact and were skipped.
+	 */
+	std::uint64_t skipped;
+	/**
+	 * Sum of the X coordinates of the active contacts. Updated incrementally
+	 * as contacts start, end, and move so that the centroid can be found
+	 * without visiting each slot.
+	 */
+	std::int64_t sumX;
+	/**
+	 * Sum of the Y coordinates of the active contacts.
+	 */
+	std::int64_t sumY;
+	/**
+	 * Sum of the squares of both coordinates of the active contacts. Used
+	 * to find the spread.
+	 */
+	std::int64_t sumSq;
+	/**
+	 * The centroid of the active contacts as of the last synEvent(), in
+	 * output coordinates.
+	 */
+	int centX;
+	/**
+	 * The centroid of the active contacts as of the last synEvent().
+	 */
+	int centY;
+	/**
+	 * The mean squared distance of the active contacts from their centroid
+	 * as of the last synEvent().
+	 */
+	std::int64_t spread;
+	/**
+	 * The number of fractional bits in @a pairDist and @a pinchTotal.
+	 */
+	static constexpr int pairFrac = 8;
+	/**
+	 * The number of fractional bits in angles, which are in radians.
+	 */
+	static constexpr int twistFrac = 16;
+	/**
+	 * The rotation that turns the wheel one detent: 15 degrees in radians,
+	 * with @a twistFrac fractional bits.
+	 */
+	static constexpr int twistDetent = 17157;
+	/**
+	 * The vector between the two contacts, in output coordinates, given to
+	 * pairFrame() during the current frame.
+	 */
+	int pairX;
+	/**
+	 * The vector between the two contacts.
+	 */
+	int pairY;
+	/**
+	 * The vector between the two contacts in the previous frame.
+	 */
+	int pairOldX;
+	/**
+	 * The vector between the two contacts in the previous frame.
+	 */
+	int pairOldY;
+	/**
+	 * The distance between the two contacts, with @a pairFrac fractional
+	 * bits, or zero if there are not exactly two contacts. Updated each
+	 * frame with one step of Newton's method rather than a square root.
+	 */
+	std::int64_t pairDist;
+	/**
+	 * The change in @a pairDist since the two contacts started.
+	 */
+	std::int64_t pinchTotal;
+	/**
+	 * The rotation of the two contacts since they started, in radians with
+	 * @a twistFrac fractional bits.
+	 */
+	std::int64_t twistTotal;
+	/**
+	 * True if pairFrame() was called during the current frame.
+	 */
+	bool pairNew;
+	/**
+	 * The location that gestures follow. It moves with the centroid, but does
+	 * not jump when contacts are added or removed during an operation.
+	 */
+	int anchorX;
+	/**
+	 * The location that gestures follow.
+	 */
+	int anchorY;
+public:
+	/**
+	 * Gestures that may be bound to a Chord.
+	 */
+	enum Gesture {
+		Tap4,
+		Tap5,
+		Swipe3Up,
+		Swipe3Down,
+		Swipe3Left,
+		Swipe3Right,
+		Swipe4Up,
+		Swipe4Down,
+		Swipe4Left,
+		Swipe4Right,
+		FlickUp,
+		FlickDown,
+		FlickLeft,
+		FlickRight,
+		GestureCount
+	};
+	/**
+	 * Settings that may be changed while translating.
+	 */
+	struct Config {
+		/**
+		 * The minimum distance an initial contact must move before it is
+		 * considered to have moved. Mitigates apparent noise in the location.
+		 */
+		int moveDist;
+		/**
+		 * The distance contacts must move to scroll by one detent of a
+		 * traditional mouse wheel.
+		 */
+		int scrollDist;
+		/**
+		 * True to continue scrolling with decaying velocity after the
+		 * contacts are lifted.
+		 */
+		bool kinetic;
+		/**
+		 * Contacts with a major axis longer than this, in the touchscreen's
+		 * units, are rejected. Zero disables the check.
+		 */
+		int maxMajor;
+		/**
+		 * Contacts with a minor axis longer than this are rejected. Zero
+		 * disables the check.
+		 */
+		int maxMinor;
+		/**
+		 * Contacts that start with less pressure than this are rejected.
+		 * Zero disables the check. Has no effect if the touchscreen does not
+		 * report pressure.
+		 */
+		int minPressure;
+		/**
+		 * The change in distance between two contacts, in pixels, that
+		 * zooms by one detent of a traditional mouse wheel. The zoom is
+		 * reported as wheel motion with the control key held. Zero disables
+		 * pinch zooming.
+		 */
+		int pinchDist;
+		/**
+		 * True to report rotation of two contacts as horizontal wheel
+		 * motion with the control key held; one detent per 15 degrees.
+		 */
+		bool twist;
+		/**
+		 * The time, in milliseconds, that a single contact must stay in
+		 * place to click @a holdButton. Zero disables long presses.
+		 */
+		int holdTime;
+		/**
+		 * The button clicked by a long press.
+		 */
+		std::uint16_t holdButton;
+		/**
+		 * The buttons used for taps and drags with one, two, and three
+		 * contacts.
+		 */
+		std::uint16_t buttons[3];
+		/**
+		 * The percentage of quick touches after a tap, as used for drags and
+		 * double taps, that the tap window is shortened to cover. Zero keeps
+		 * the window at @a tapMax.
+		 */
+		int tapPercentile;
+		/**
+		 * The shortest tap window in milliseconds.
+		 */
+		int tapMin;
+		/**
+		 * The longest tap window in milliseconds; touching again within it
+		 * after a tap starts a drag.
+		 */
+		int tapMax;
+		/**
+		 * The speed, in pixels per second, that a single contact must be
+		 * moving when lifted to be a flick.
+		 */
+		int flickSpeed;
+		/**
+		 * Parts of the screen with their own response to touch. The region
+		 * where a gesture starts governs the whole gesture. Earlier regions
+		 * take precedence where they overlap.
+		 */
+		std::vector<Region> regions;
+		/**
+		 * The keys sent for each Gesture; empty for none. Binding any swipe
+		 * with three contacts replaces two-axis scrolling.
+		 */
+		Chord bindings[GestureCount];
+		/**
+		 * True to ignore touch input. The touchscreen remains grabbed.
+		 */
+		bool paused;
+		Config() : moveDist(8), scrollDist(8), kinetic(false),
+		maxMajor(0), maxMinor(0), minPressure(0),
+		pinchDist(32), twist(false),
+		holdTime(0), holdButton(BTN_RIGHT), buttons{ BTN_LEFT, BTN_RIGHT, BTN_MIDDLE },
+		tapPercentile(95), tapMin(80), tapMax(192), flickSpeed(1200),
+		paused(false) { }
+		/**
+		 * The keys used by the regions and bindings, each listed once. The
+		 * output device is made with these in addition to the buttons.
+		 */
+		std::vector<std::uint16_t> keys() const;
+	};
+	/**
+	 * Counts of contacts rejected before gesture recognition, by reason.
+	 */
+	struct RejectStats {
+		/**
+		 * Contacts too large to be a finger.
+		 */
+		std::uint64_t size;
+		/**
+		 * Contacts that started too lightly.
+		 */
+		std::uint64_t pressure;
+		/**
+		 * Contacts the touchscreen reported as a palm.
+		 */
+		std::uint64_t palm;
+	};
+	/**
+	 * The state needed to continue translating in another process without
+	 * disturbing contacts already on the touchscreen. Sent as raw bytes, so
+	 * it only contains fixed-size integers.
+	 */
+	struct Snapshot {
+		/**
+		 * A contact in progress.
+		 */
+		struct Contact {
+			std::int32_t slot;
+			std::int32_t tid;
+			std::int32_t x;
+			std::int32_t y;
+			std::int32_t major;
+			std::int32_t minor;
+			std::int32_t pressure;
+		};
+		std::int32_t cursorX;
+		std::int32_t cursorY;
+		/**
+		 * The slot last selected by the touchscreen; it only reports a slot
+		 * when it changes.
+		 */
+		std::int32_t slot;
+		/**
+		 * The number of items used in @a contact.
+		 */
+		std::int32_t contacts;
+		Contact contact[maxSlots];
+	};
+protected:
+	/**
+	 * Rejected contact counters.
+	 */
+	RejectStats rejects;
+	/**
+	 * Receives the touch state after each frame, if not null.
+	 */
+	StatePublisher *publisher;
+	/**
+	 * The settings in use.
+	 */
+	Config cfg;
+	/**
+	 * Settings given to configure() during a frame; they are put into use
+	 * at the end of the frame.
+	 */
+	Config pendingCfg;
+	/**
+	 * True if @a pendingCfg needs to be put into use.
+	 */
+	bool havePending;
+	/**
+	 * True after input events for a frame have arrived, until the frame is
+	 * complete.
+	 */
+	bool midFrame;
+	/**
+	 * True if the touchscreen reports contact pressure.
+	 */
+	bool hasPressure;
+	/**
+	 * Puts new settings into use.
+	 */
+	void apply(const Config &c);
+	/**
+	 * Releases the button held by a drag operation, or the control key held
+	 * by a pinch or rotate operation, if any.
+	 */
+	void releaseButtons();
+	/**
+	 * Adds or removes a slot's position from the coordinate sums.
+	 * @param ss    The slot.
+	 * @param sign  1 to add, -1 to remove.
+	 */
+	void sumSlot(const SlotState &ss, int sign);
+	/**
+	 * Supplies the locations of the two contacts when there are exactly two.
+	 * Called by the subclass before synEvent().
+	 */
+	void pairFrame(const SlotState &a, const SlotState &b);
+	/**
+	 * Updates the distance and angle between two contacts.
+	 * @param pinch  The change in distance since the last frame, with
+	 *               @a pairFrac fractional bits.
+	 * @param turn   The rotation since the last frame, in radians with
+	 *               @a twistFrac fractional bits.
+	 */
+	void pairMotion(int &pinch, int &turn);
 	/**
 	 * The number of contacts that the operation is responding to. This may be
 	 * different from @a scnt.
@@ -102,67 +579,290 @@ class MtTranslate {
 		MoveCursor,
 		ScrollVert,
 		ScrollHoriz,
-		Scroll2D  // 3-finger scroll; seems to not work with Firefox
+		Scroll2D,  // 3-finger scroll; seems to not work with Firefox
+		Pinch,
+		Rotate,
+		Held,  // long press done; waiting for the contact to end
+		Ignored,  // started in an ignored region or done with an edge swipe
+		Pressed,  // started in a click region; left button held
+		Edge  // started in a key region; waiting for motion
 	};
 	/**
 	 * The current mouse-like input operation.
 	 */
 	int curOp;
 	/**
-	 * The minimum distance an initial contact must move before it is considered
-	 * to have moved. Mitigates apparent noise in the location.
+	 * Starts the operation for a gesture that begins in a region with an
+	 * action other than Region::Gestures. The cursor is at the contacts.
+	 * @param r  The index of the region in the settings.
+	 */
+	void regionStart(int r);
+	/**
+	 * True if any swipe with the given number of contacts is bound.
 	 */
-	int moveDist;
+	bool swipeBound(int contacts) const;
 	/**
-	 * Responds to ABS_MT_SLOT input events.
+	 * Sends the chord for a swipe in the direction the contacts moved most,
+	 * if bound, then ignores the rest of the gesture.
 	 */
-	void slotEvent(std::int32_t val);
+	void swipe(int contacts, int deltaX, int deltaY);
 	/**
-	 * Responds to ABS_MT_TRACKING_ID input events.
+	 * The flick Gesture made by lifting the contacts at @a liftVelX and
+	 * @a liftVelY, or -1 if they were too slow.
 	 */
-	void trackEvent(std::int32_t val);
+	int flick() const;
 	/**
-	 * Responds to ABS_MT_POSITION_X input events.
+	 * Converts contact motion into high-resolution scroll units for the
+	 * given axis, keeping any remainder for later, and reports the result.
+	 * @param sa      The axis to scroll.
+	 * @param pixels  The distance the contacts moved along the axis.
+	 * @return        The number of high-resolution units reported.
 	 */
-	void xPosEvent(std::int32_t val);
+	int scroll(ScrollAxis &sa, int pixels);
 	/**
-	 * Responds to ABS_MT_POSITION_Y input events.
+	 * Reports high-resolution scroll units, along with legacy wheel events
+	 * once enough units accumulate to make a full detent. Does not sync.
 	 */
-	void yPosEvent(std::int32_t val);
+	void wheel(ScrollAxis &sa, int hires);
 	/**
-	 * Responds to SYN_REPORT input events.
+	 * Reports a change in distance between two contacts as wheel motion.
+	 * @param change  The change in distance with @a pairFrac fractional bits.
+	 * @return        The number of high-resolution units reported.
 	 */
-	void synEvent();
+	int pinchWheel(int change);
 	/**
-	 * Initialization function called by all constructors.
+	 * Reports rotation of two contacts as horizontal wheel motion.
+	 * @param turn  The rotation in radians with @a twistFrac fractional bits.
+	 * @return      The number of high-resolution units reported.
 	 */
-	void init();
+	int rotateWheel(int turn);
 	/**
-	 * A length of time between tap-like contacts of the screen used to
+	 * Starts kinetic scrolling if enabled and the contacts were moving when
+	 * lifted.
+	 */
+	void startKinetic(timepoint currtime);
+	/**
+	 * Stops kinetic scrolling.
+	 */
+	void stopKinetic();
+	/**
+	 * Called by @a kineticTimer to report scrolling with decaying velocity.
+	 */
+	void kineticHandle();
+	/**
+	 * Handles a complete frame of input. Called by the subclass in response
+	 * to SYN_REPORT input events once it has checked new contacts for
+	 * rejection.
+	 * @param currtime  The time the frame is handled.
+	 */
+	void synEvent(timepoint currtime);
+	/**
+	 * The length of time between tap-like contacts of the screen used to
 	 * implement different behavior when an operation requires mutlple contacts
-	 * over time.
+	 * over time. Learned from how quickly the user touches again after a tap.
 	 */
-	static constexpr std::chrono::milliseconds tapTime =
-		std::chrono::milliseconds(192);
+	TapWindow tapWindow;
 	/**
-	 * Logs to stdout what is going on for debugging.
+	 * True after a tap ends until the screen is touched again.
+	 */
+	bool tapped;
+	/**
+	 * The period of the kinetic scrolling timer.
+	 */
+	static constexpr std::chrono::milliseconds kineticTick =
+		std::chrono::milliseconds(16);
+	/**
+	 * The longest time between the last scroll motion and lifting the
+	 * contacts that still starts kinetic scrolling.
+	 */
+	static constexpr std::chrono::milliseconds kineticHold =
+		std::chrono::milliseconds(48);
+	/**
+	 * The slowest kinetic scroll velocity, in high-resolution units per
+	 * second. Kinetic scrolling stops once the velocity decays below it.
+	 */
+	static constexpr int kineticMinVel = 240;
+	/**
+	 * The age of the oldest sample of a contact's motion used to find its
+	 * velocity when lifted.
+	 */
+	static constexpr std::chrono::milliseconds flickSpan =
+		std::chrono::milliseconds(100);
+	/**
+	 * The velocity, in output pixels per second, of the contacts lifted in
+	 * the current frame if no contacts remain, or zero. Found by the
+	 * subclass before synEvent() from the motion of each contact.
+	 */
+	int liftVelX;
+	/**
+	 * The velocity of the lifted contacts along the Y axis.
+	 */
+	int liftVelY;
+	/**
+	 * Ends the current operation and records the state that is not kept by
+	 * the subclass.
+	 */
+	void saveState(Snapshot &s);
+	/**
+	 * Resumes from a snapshot after the subclass has restored the contacts.
+	 */
+	void restoreState(const Snapshot &s);
+	/**
+	 * Clicks the button for a tap once the time for a second tap has passed.
+	 */
+	void tapTimeout(timepoint currtime);
+	/**
+	 * Clicks the long press button if the contact has stayed in place.
+	 */
+	void holdTimeout(timepoint currtime);
+	/**
+	 * Logs what is going on for debugging at the Log::Debug level.
 	 */
 	void logstate() const;
+	/**
+	 * Makes a new input translator using the given device for input. The
+	 * subclass connects to the touchscreen's input signals.
+	 * @param ev  The touchscreen.
+	 * @param xf  The transformation from touchscreen coordinates to output
+	 *            coordinates. It also sets the output's axis ranges.
+	 * @param c   The initial settings.
+	 * @param s   The destination of the output events. If empty, a uinput
+	 *            device is made.
+	 */
+	MtTranslate(
+		const EvdevShared &ev,
+		const Transform &xf,
+		const Config &c,
+		OutputSinkPtr &&s
+	);
 public:
 	/**
-	 * Makes a new input translator using the given device for input.
+	 * Makes a new input translator with storage for contacts fixed at compile
+	 * time to the smallest size that fits the touchscreen's slots. Devices
+	 * with more than ten slots use storage sized at run time.
+	 * @param ev  The touchscreen.
+	 * @param xf  The transformation from touchscreen coordinates to output
+	 *            coordinates. It also sets the output's axis ranges.
+	 * @param c   The initial settings.
+	 * @param s   The destination of the output events. If empty, a uinput
+	 *            device is made.
 	 */
-	MtTranslate(const EvdevShared &ev, int movethres);
+	static std::unique_ptr<MtTranslate> make(
+		const EvdevShared &ev,
+		const Transform &xf,
+		const Config &c = Config(),
+		OutputSinkPtr &&s = OutputSinkPtr()
+	);
 	/**
-	 * Makes a new input translator using the given device for input.
+	 * Disconnects from the touchscreen and releases any button held down by
+	 * a drag operation.
 	 */
-	MtTranslate(EvdevShared &&ev, int movethres);
-	// disconnect signal functions given to evdev
-	~MtTranslate();
+	virtual ~MtTranslate();
 	/**
-	 * Call to handle single-tap button presses. These occur after the tap
-	 * when no other touch input is given. As a result, it cannot be in
-	 * synEvent() because there will not be an event.
+	 * The number of slots for which storage is kept.
+	 */
+	virtual int slotCapacity() const = 0;
+	/**
+	 * Prepares to hand the touchscreen to another process. Any held button
+	 * is released and kinetic scrolling stops, then the contacts in progress
+	 * are recorded. Must not be called during a frame.
+	 */
+	virtual void save(Snapshot &s) = 0;
+	/**
+	 * Continues from the state recorded by save() in another process. Must
+	 * be called before any input is handled.
+	 */
+	virtual void restore(const Snapshot &s) = 0;
+	/**
+	 * The output device.
+	 */
+	EvdevOutput &output() {
+		return eo;
+	}
+	const EvdevOutput &output() const {
+		return eo;
+	}
+	/**
+	 * Registers the timer used for kinetic scrolling with the poller, and
+	 * lets the output be written through it.
+	 */
+	void usePoller(Poller &p);
+	/**
+	 * Writes the touch state to the given publisher after each frame from
+	 * now on. The publisher is cleared when this object is destroyed, and
+	 * must outlast it.
+	 * @param sp  The publisher, or null to stop publishing.
+	 */
+	void publishTo(StatePublisher *sp);
+	/**
+	 * Changes the settings. If called while a frame of input is only
+	 * partly received, the change takes effect at the end of the frame so
+	 * that a frame is never handled with a mix of settings. Pausing releases
+	 * any held button and stops kinetic scrolling.
+	 */
+	void configure(const Config &c);
+	/**
+	 * The settings in use, or that will be in use at the end of the current
+	 * frame.
+	 */
+	const Config &config() const {
+		return havePending ? pendingCfg : cfg;
+	}
+	/**
+	 * The name of the current operation.
+	 */
+	const char *operationName() const;
+	/**
+	 * The name of a Gesture as used for binding, like "swipe3left".
+	 */
+	static const char *gestureName(int g);
+	/**
+	 * Finds a Gesture by name.
+	 * @return  The gesture, or -1 if the name is unknown.
+	 */
+	static int gestureNamed(const std::string &name);
+	/**
+	 * The number of contacts in use as of the last complete frame.
+	 */
+	int contacts() const {
+		return scnt;
+	}
+	/**
+	 * Reports the number of rejected contacts.
+	 */
+	const RejectStats &rejectStats() const {
+		return rejects;
+	}
+	/**
+	 * The number of frames skipped because no contact changed. Many
+	 * touchscreens report frames at a fixed rate while touched, even when
+	 * the contacts are still.
+	 */
+	std::uint64_t skippedFrames() const {
+		return skipped;
+	}
+	/**
+	 * The current tap window.
+	 */
+	std::chrono::milliseconds tapTime() const {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			tapWindow.window()
+		);
+	}
+	/**
+	 * The time until timeoutHandle() next needs to be called, for use as
+	 * the poll timeout, or -1 if nothing is pending.
+	 */
+	std::chrono::milliseconds timeout() const {
+		return deadlines.timeout(std::chrono::steady_clock::now());
+	}
+	/**
+	 * Call when the time given by timeout() has passed to handle gestures
+	 * that complete without further input, like single-tap button presses
+	 * and long presses. These cannot be in synEvent() because there will not
+	 * be an event. Does nothing if no deadline has passed.
 	 */
 	void timeoutHandle();
 };
+
+#endif        //  #ifndef MTTRANSLATE_HPP
@@ -0,0 +1,460 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef MTTRANSLATESLOTS_HPP
+#define MTTRANSLATESLOTS_HPP
+
+#include "MtTranslate.hpp"
+#include "MotionHistory.hpp"
+#include "StatePublisher.hpp"
+#include <algorithm>
+
+/**
+ * Storage for per-slot data with a size fixed at compile time. The data is
+ * kept inside the translator object so that all of the touch state is
+ * together in memory.
+ * @tparam T      The type of data kept for each slot.
+ * @tparam Slots  The number of slots.
+ * @author  Jeff Jackowski
+ */
+template <class T, int Slots>
+class SlotTable {
+	T table[Slots];
+public:
+	SlotTable(int) { }
+	static constexpr int size() {
+		return Slots;
+	}
+	T &operator[](int s) {
+		return table[s];
+	}
+	const T &operator[](int s) const {
+		return table[s];
+	}
+};
+
+/**
+ * Storage for per-slot data with a size chosen at run time, used for
+ * touchscreens with more slots than any of the fixed sizes.
+ */
+template <class T>
+class SlotTable<T, 0> {
+	std::vector<T> table;
+public:
+	SlotTable(int n) : table(n) { }
+	int size() const {
+		return (int)table.size();
+	}
+	T &operator[](int s) {
+		return table[s];
+	}
+	const T &operator[](int s) const {
+		return table[s];
+	}
+};
+
+/**
+ * Multi-touch translator specialized for a number of slots. It keeps the
+ * state of each contact and handles the input events that change it; the
+ * gesture recognition done with the combined result is left to MtTranslate.
+ * With a fixed number of slots, the check for an out of range slot is
+ * against a constant, and the contact data does not need a separate
+ * allocation.
+ * @tparam Slots  The number of slots to track, or zero to use the number
+ *                reported by the touchscreen up to MtTranslate::maxSlots.
+ * @author  Jeff Jackowski
+ */
+template <int Slots>
+class MtTranslateSlots : public MtTranslate {
+	static_assert(
+		(Slots >= 0) && (Slots <= maxSlots),
+		"Slot count must fit in SlotMask"
+	);
+	static_assert(
+		TouchFrame::maxContacts >= maxSlots,
+		"Every slot must fit in the published state"
+	);
+	/**
+	 * Data on each of the "slots", stateful contact points reported by
+	 * multi-touch protocol B.
+	 */
+	SlotTable<SlotState, Slots> slots;
+	/**
+	 * The recent motion of the contact in each slot. Kept apart from
+	 * @a slots since it is only visited for contacts that moved.
+	 */
+	SlotTable<MotionHistory, Slots> motion;
+	/**
+	 * Removes the contact in the given slot from consideration until it ends.
+	 * @param s        The slot.
+	 * @param counter  The counter to increment if the contact was not
+	 *                 already rejected.
+	 */
+	void reject(int s, std::uint64_t &counter) {
+		SlotMask bit = SlotMask(1) << s;
+		if (rejected & bit) {
+			return;
+		}
+		if (active & bit) {
+			active &= ~bit;
+			sumSlot(slots[s], -1);
+			if (activeOld & bit) {
+				abandoned = true;
+			}
+		}
+		rejected |= bit;
+		fresh &= ~bit;
+		dirty |= bit;
+		++counter;
+	}
+	/**
+	 * Responds to ABS_MT_SLOT input events.
+	 */
+	void slotEvent(std::int32_t val) {
+		midFrame = true;
+		// ignore slots beyond those that are tracked
+		if ((val >= 0) && (val < slots.size())) {
+			slot = val;
+		} else {
+			slot = -1;
+		}
+	}
+	/**
+	 * Responds to ABS_MT_TRACKING_ID input events.
+	 */
+	void trackEvent(std::int32_t val) {
+		midFrame = true;
+		if (slot < 0) {
+			return;
+		}
+		SlotState &ss = slots[slot];
+		SlotMask bit = SlotMask(1) << slot;
+		if (val < 0) {
+			if (active & bit) {
+				active &= ~bit;
+				dirty |= bit;
+				sumSlot(ss, -1);
+			}
+			rejected &= ~bit;
+			fresh &= ~bit;
+		} else {
+			// a different ID means a new contact
+			if (val != ss.tid) {
+				rejected &= ~bit;
+				dirty |= bit;
+			}
+			if (!(active & bit) && !(rejected & bit)) {
+				active |= bit;
+				fresh |= bit;
+				dirty |= bit;
+				motion[slot].clear();
+				// the position events that follow only report changes, so
+				// the last known position is used until then
+				sumSlot(ss, 1);
+			}
+		}
+		ss.tid = val;
+	}
+	/**
+	 * Responds to ABS_MT_POSITION_X input events.
+	 */
+	void xPosEvent(std::int32_t val) {
+		midFrame = true;
+		if (slot < 0) {
+			return;
+		}
+		SlotState &ss = slots[slot];
+		SlotMask bit = SlotMask(1) << slot;
+		if ((active & bit) && (val != ss.x)) {
+			dirty |= bit;
+			sumX += val - ss.x;
+			sumSq += (std::int64_t)val * val - (std::int64_t)ss.x * ss.x;
+		}
+		ss.x = val;
+	}
+	/**
+	 * Responds to ABS_MT_POSITION_Y input events.
+	 */
+	void yPosEvent(std::int32_t val) {
+		midFrame = true;
+		if (slot < 0) {
+			return;
+		}
+		SlotState &ss = slots[slot];
+		SlotMask bit = SlotMask(1) << slot;
+		if ((active & bit) && (val != ss.y)) {
+			dirty |= bit;
+			sumY += val - ss.y;
+			sumSq += (std::int64_t)val * val - (std::int64_t)ss.y * ss.y;
+		}
+		ss.y = val;
+	}
+	/**
+	 * Responds to ABS_MT_TOUCH_MAJOR input events.
+	 */
+	void majorEvent(std::int32_t val) {
+		midFrame = true;
+		if (slot < 0) {
+			return;
+		}
+		slots[slot].major = val;
+		if (cfg.maxMajor && (val > cfg.maxMajor) && (slots[slot].tid >= 0)) {
+			reject(slot, rejects.size);
+		}
+	}
+	/**
+	 * Responds to ABS_MT_TOUCH_MINOR input events.
+	 */
+	void minorEvent(std::int32_t val) {
+		midFrame = true;
+		if (slot < 0) {
+			return;
+		}
+		slots[slot].minor = val;
+		if (cfg.maxMinor && (val > cfg.maxMinor) && (slots[slot].tid >= 0)) {
+			reject(slot, rejects.size);
+		}
+	}
+	/**
+	 * Responds to ABS_MT_PRESSURE input events.
+	 */
+	void pressureEvent(std::int32_t val) {
+		midFrame = true;
+		if (slot >= 0) {
+			slots[slot].pressure = val;
+		}
+	}
+	/**
+	 * Responds to ABS_MT_TOOL_TYPE input events.
+	 */
+	void toolEvent(std::int32_t val) {
+		midFrame = true;
+		if ((slot >= 0) && (val == MT_TOOL_PALM) && (slots[slot].tid >= 0)) {
+			reject(slot, rejects.palm);
+		}
+	}
+	/**
+	 * Responds to SYN_REPORT input events.
+	 */
+	void frameEvent() {
+		// check new contacts against limits that need the whole frame; the
+		// size limits are checked as the values arrive
+		for (SlotMask f = fresh; f; f &= f - 1) {
+			int s = __builtin_ctzll(f);
+			const SlotState &ss = slots[s];
+			if (
+				(cfg.maxMajor && (ss.major > cfg.maxMajor)) ||
+				(cfg.maxMinor && (ss.minor > cfg.maxMinor))
+			) {
+				reject(s, rejects.size);
+			} else if (
+				cfg.minPressure && hasPressure &&
+				(ss.pressure < cfg.minPressure)
+			) {
+				reject(s, rejects.pressure);
+			}
+		}
+		fresh = 0;
+		// a frame that changes no contact, as sent at a fixed rate by some
+		// touchscreens, would only repeat the last result; gestures that
+		// complete with time alone are handled by timeoutHandle()
+		if (!dirty && (active == activeOld) && !havePending) {
+			midFrame = false;
+			++skipped;
+			return;
+		}
+		timepoint now = std::chrono::steady_clock::now();
+		// motion is timed by the kernel since frames read together would
+		// otherwise seem to happen at once; both use the monotonic clock
+		std::int64_t us = evdev->eventTime();
+		if (!us) {
+			us = std::chrono::duration_cast<std::chrono::microseconds>(
+				now.time_since_epoch()
+			).count();
+		}
+		for (SlotMask d = dirty & active; d; d &= d - 1) {
+			int s = __builtin_ctzll(d);
+			motion[s].add(us, slots[s].x, slots[s].y);
+		}
+		dirty = 0;
+		liftVelX = liftVelY = 0;
+		if (!active && activeOld) {
+			liftVelocity(us);
+		}
+		// pinch and rotate use the locations of exactly two contacts
+		SlotMask rest = active & (active - 1);
+		if (rest && !(rest & (rest - 1))) {
+			pairFrame(
+				slots[__builtin_ctzll(active)],
+				slots[__builtin_ctzll(rest)]
+			);
+		}
+		synEvent(now);
+		if (publisher) {
+			publish();
+		}
+	}
+	/**
+	 * Finds the average velocity of the contacts that were just lifted and
+	 * puts it in @a liftVelX and @a liftVelY.
+	 * @param now  The time of the frame in microseconds.
+	 */
+	void liftVelocity(std::int64_t now) {
+		const std::int64_t hold =
+			std::chrono::microseconds(kineticHold).count();
+		const std::int64_t span = std::chrono::microseconds(flickSpan).count();
+		std::int64_t sumVX = 0, sumVY = 0;
+		int count = 0;
+		for (SlotMask e = activeOld; e; e &= e - 1) {
+			const MotionHistory &mh = motion[__builtin_ctzll(e)];
+			int vx, vy;
+			// a contact that stopped before it was lifted adds no velocity
+			if (
+				!mh.empty() && (now - mh.latest().time <= hold) &&
+				mh.velocity(now - span, vx, vy)
+			) {
+				sumVX += vx;
+				sumVY += vy;
+			}
+			++count;
+		}
+		int vx = (int)(sumVX / count);
+		int vy = (int)(sumVY / count);
+		xform.applyVector(vx, vy);
+		liftVelX = vx;
+		liftVelY = vy;
+	}
+	/**
+	 * Writes the state at the end of a frame to @a publisher.
+	 */
+	void publish() {
+		TouchFrame &f = publisher->begin();
+		f.operation = curOp;
+		f.paused = cfg.paused;
+		f.active = active;
+		f.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count();
+		++f.frames;
+		f.cursorX = cursorX;
+		f.cursorY = cursorY;
+		// only the active slots are current
+		for (SlotMask a = active; a; a &= a - 1) {
+			int s = __builtin_ctzll(a);
+			TouchFrame::Contact &c = f.contact[s];
+			c.tid = slots[s].tid;
+			c.x = slots[s].x;
+			c.y = slots[s].y;
+			xform.apply(c.x, c.y);
+		}
+		publisher->end();
+	}
+	/**
+	 * Connects a handler to one of the touchscreen's absolute axes.
+	 */
+	void connect(int code, void (MtTranslateSlots::*handler)(std::int32_t)) {
+		conns.emplace_back(evdev->inputConnect(
+			EventTypeCode(EV_ABS, code),
+			std::bind(handler, this, std::placeholders::_2)
+		));
+	}
+public:
+	/**
+	 * Makes a new input translator using the given device for input.
+	 * @param ev  The touchscreen.
+	 * @param xf  The transformation from touchscreen coordinates to output
+	 *            coordinates. It also sets the output's axis ranges.
+	 * @param c   The initial settings.
+	 * @param s   The destination of the output events. If empty, a uinput
+	 *            device is made.
+	 */
+	MtTranslateSlots(
+		const EvdevShared &ev,
+		const Transform &xf,
+		const Config &c = Config(),
+		OutputSinkPtr &&s = OutputSinkPtr()
+	) :
+	MtTranslate(ev, xf, c, std::move(s)),
+	slots(std::max(std::min(ev->numSlots(), (int)maxSlots), 0)),
+	motion(slots.size()) {
+		if (slots.size() > 0) {
+			slot = 0;
+		}
+		// configure reception of mulit-touch input events
+		connect(ABS_MT_SLOT, &MtTranslateSlots::slotEvent);
+		connect(ABS_MT_TRACKING_ID, &MtTranslateSlots::trackEvent);
+		connect(ABS_MT_POSITION_X, &MtTranslateSlots::xPosEvent);
+		connect(ABS_MT_POSITION_Y, &MtTranslateSlots::yPosEvent);
+		// contact properties used to reject palms, if supported
+		if (evdev->hasEventCode(EV_ABS, ABS_MT_TOUCH_MAJOR)) {
+			connect(ABS_MT_TOUCH_MAJOR, &MtTranslateSlots::majorEvent);
+		}
+		if (evdev->hasEventCode(EV_ABS, ABS_MT_TOUCH_MINOR)) {
+			connect(ABS_MT_TOUCH_MINOR, &MtTranslateSlots::minorEvent);
+		}
+		if (evdev->hasEventCode(EV_ABS, ABS_MT_PRESSURE)) {
+			connect(ABS_MT_PRESSURE, &MtTranslateSlots::pressureEvent);
+		}
+		if (evdev->hasEventCode(EV_ABS, ABS_MT_TOOL_TYPE)) {
+			connect(ABS_MT_TOOL_TYPE, &MtTranslateSlots::toolEvent);
+		}
+		conns.emplace_back(evdev->inputConnect(
+			EventTypeCode(EV_SYN, SYN_REPORT),
+			std::bind(&MtTranslateSlots::frameEvent, this)
+		));
+	}
+	/**
+	 * Disconnects from the touchscreen before the slot data is destroyed.
+	 */
+	virtual ~MtTranslateSlots() {
+		conns.clear();
+	}
+	virtual int slotCapacity() const {
+		return slots.size();
+	}
+	virtual void save(Snapshot &s) {
+		saveState(s);
+		s.contacts = 0;
+		for (SlotMask a = active; a; a &= a - 1) {
+			int i = __builtin_ctzll(a);
+			const SlotState &ss = slots[i];
+			s.contact[s.contacts++] = Snapshot::Contact {
+				i, ss.tid, ss.x, ss.y, ss.major, ss.minor, ss.pressure
+			};
+		}
+	}
+	virtual void restore(const Snapshot &s) {
+		for (int c = 0; (c < s.contacts) && (c < maxSlots); ++c) {
+			const Snapshot::Contact &sc = s.contact[c];
+			if ((sc.slot < 0) || (sc.slot >= slots.size())) {
+				continue;
+			}
+			SlotState &ss = slots[sc.slot];
+			ss.tid = sc.tid;
+			ss.x = sc.x;
+			ss.y = sc.y;
+			ss.major = sc.major;
+			ss.minor = sc.minor;
+			ss.pressure = sc.pressure;
+			SlotMask bit = SlotMask(1) << sc.slot;
+			if (!(active & bit)) {
+				active |= bit;
+				sumSlot(ss, 1);
+			}
+		}
+		restoreState(s);
+		if ((slot < -1) || (slot >= slots.size())) {
+			slot = -1;
+		}
+	}
+};
+
+#endif        //  #ifndef MTTRANSLATESLOTS_HPP
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef OUTPUTSINK_HPP
+#define OUTPUTSINK_HPP
+
+#include <linux/input.h>
+#include <memory>
+
+class Poller;
+
+/**
+ * The destination of the input events made by the translator. EvdevOutput
+ * collects events into frames and gives each complete frame to a sink.
+ * Implementations may be called from the writer thread started by
+ * EvdevOutput::startPipeline(), but never from more than one thread at a
+ * time.
+ * @author  Jeff Jackowski
+ */
+class OutputSink {
+public:
+	virtual ~OutputSink() { }
+	/**
+	 * Delivers a frame of input events. A frame normally ends with a
+	 * SYN_REPORT event.
+	 * @param events  The events.
+	 * @param count   The number of events.
+	 * @throw EvdevError  The events could not be delivered.
+	 */
+	virtual void write(const input_event *events, int count) = 0;
+	/**
+	 * Lets the sink queue its writes on the poller so that they are
+	 * submitted with the poller's next wait. Only used while the sink is
+	 * called from the thread that waits on the poller. Sinks write directly
+	 * by default.
+	 * @param p  The poller, or nullptr to write directly.
+	 */
+	virtual void usePoller(Poller *p) { }
+};
+
+typedef std::unique_ptr<OutputSink>  OutputSinkPtr;
+
+#endif        //  #ifndef OUTPUTSINK_HPP
@@ -9,11 +9,598 @@
  *
  * Copyright (C) 2018  Jeff Jackowski
  */
+#include <boost/container/small_vector.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 #include "Poller.hpp"
+#include "AllocCount.hpp"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cstring>
 #include <vector>
 
-Poller::Poller() {
+struct ResponseRecord {
+	PollResponseShared prs;
+	/**
+	 * Data read by io_uring, or nullptr for a readiness event.
+	 */
+	const void *data;
+	int fd;
+	/**
+	 * The result of the read; unused for a readiness event.
+	 */
+	int size;
+	ResponseRecord(const PollResponseShared &p, int f) :
+	prs(p), data(nullptr), fd(f), size(0) { }
+	ResponseRecord(const PollResponseShared &p, int f, const void *d, int s) :
+	prs(p), data(d), fd(f), size(s) { }
+};
+
+/**
+ * The responders to call after a wait. Space for more than are normally ready
+ * at once is kept on the stack so that waiting does not allocate.
+ */
+typedef boost::container::small_vector<ResponseRecord, 32> ResponseRecords;
+
+/**
+ * An io_uring used for poll requests, reads kept outstanding on input, and
+ * queued writes. It is used through system calls directly since liburing is
+ * not required.
+ */
+struct Poller::Ring : boost::noncopyable {
+	/**
+	 * The number of submission queue entries.
+	 */
+	static constexpr unsigned entries = 64;
+	/**
+	 * The number of read buffers; each is used by one file descriptor.
+	 */
+	static constexpr unsigned readBuffers = 16;
+	/**
+	 * The size of each read buffer; holds 85 input events.
+	 */
+	static constexpr std::size_t readSize = 2048;
+	/**
+	 * The number of write buffers; one per queued write.
+	 */
+	static constexpr unsigned writeBuffers = 32;
+	/**
+	 * The size of each write buffer; holds a frame of 16 input events.
+	 */
+	static constexpr std::size_t writeSize = 512;
+	/**
+	 * Marks the user data of writes. Generations only use the lower 30 bits
+	 * so they never have it.
+	 */
+	static constexpr std::uint64_t writeTag = 1ULL << 63;
+	/**
+	 * Marks the user data of the polls linked ahead of reads; their
+	 * completions are ignored.
+	 */
+	static constexpr std::uint64_t pollTag = 1ULL << 62;
+	/**
+	 * The io_uring file descriptor.
+	 */
+	int fd;
+	/**
+	 * The mapped submission ring, completion ring, and submission entries.
+	 */
+	void *sqMap, *cqMap;
+	io_uring_sqe *sqes;
+	std::size_t sqMapSize, cqMapSize;
+	unsigned *sqTail, *sqArray;
+	unsigned sqMask;
+	unsigned *cqHead, *cqTail;
+	unsigned cqMask;
+	io_uring_cqe *cqes;
+	/**
+	 * Entries added to the submission ring that the kernel has not yet
+	 * consumed.
+	 */
+	unsigned pending;
+	/**
+	 * The read buffers followed by the write buffers.
+	 */
+	char *buffers;
+	/**
+	 * True if the buffers are registered with the kernel. Registration
+	 * avoids mapping the buffers for each request, but can fail if the
+	 * locked memory limit is low; unregistered buffers are then used.
+	 */
+	bool fixed;
+	/**
+	 * The user data of the read outstanding in each read buffer, or zero.
+	 * A buffer stays in use until its read completes, even if its file
+	 * descriptor was removed.
+	 */
+	std::uint64_t reading[readBuffers];
+	/**
+	 * The file descriptor using each read buffer, or -1.
+	 */
+	int reader[readBuffers];
+	/**
+	 * A bit for each write buffer in use.
+	 */
+	std::uint32_t writing;
+	/**
+	 * The number of writes that failed.
+	 */
+	std::uint64_t writeErrors;
+	/**
+	 * A poll or read request; identifies the file descriptor and which
+	 * addition of it to the poller the request is for, so that completions
+	 * for removed file descriptors are ignored.
+	 */
+	struct Watch {
+		std::uint32_t gen;
+		std::uint32_t events;
+		/**
+		 * The read buffer used, or -1 for a poll request.
+		 */
+		int buffer;
+	};
+	/**
+	 * The watched file descriptors.
+	 */
+	std::map<int, Watch> watches;
+	/**
+	 * Requests that completed and must be renewed after their responses are
+	 * called.
+	 */
+	std::vector<std::pair<int, std::uint32_t> > renew;
+	/**
+	 * The generation given to the next added file descriptor. Zero is not
+	 * used so that it can mark requests with ignored completions.
+	 * Generations wrap at 30 bits; see writeTag and pollTag.
+	 */
+	std::uint32_t nextGen;
+	/**
+	 * @throw PollerCreateError  io_uring is unavailable or lacks a needed
+	 *                           feature.
+	 */
+	Ring();
+	~Ring();
+	static std::uint64_t userData(int fd, std::uint32_t gen) {
+		return ((std::uint64_t)gen << 32) | (std::uint32_t)fd;
+	}
+	/**
+	 * Provides a cleared submission entry, submitting queued entries first if
+	 * the ring lacks room for the given number of entries.
+	 * @param room  The number of entries that will be added together; linked
+	 *              entries must be submitted together.
+	 */
+	io_uring_sqe *sqe(unsigned room = 1);
+	/**
+	 * Submits queued entries and optionally waits for completions.
+	 * @return  The result of io_uring_enter().
+	 */
+	int enter(
+		unsigned waitFor,
+		unsigned flags,
+		const void *arg,
+		std::size_t argSize
+	);
+	/**
+	 * Queues a poll or read request.
+	 */
+	void arm(int fd, const Watch &w);
+	/**
+	 * Queues the requests renewed by earlier completions.
+	 */
+	void rearm();
+	/**
+	 * Starts watching a file descriptor.
+	 * @param read  True to keep a read outstanding if a buffer is free.
+	 * @return      True if a read is kept outstanding.
+	 */
+	bool add(int fd, std::uint32_t events, bool read);
+	void remove(int fd);
+	/**
+	 * Copies data into a free write buffer and queues its write.
+	 * @return  False if the data is too large or no buffer is free.
+	 */
+	bool write(int fd, const void *data, std::size_t size);
+	/**
+	 * Submits queued requests without waiting.
+	 */
+	void submit();
+	/**
+	 * Waits for completions and records the responders to call.
+	 */
+	void wait(
+		std::chrono::milliseconds timeout,
+		const std::map<int, PollResponseShared> &things,
+		ResponseRecords &responders
+	);
+};
+
+Poller::Ring::Ring() :
+pending(0), fixed(false), writing(0), writeErrors(0), nextGen(1) {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0) {
+		BOOST_THROW_EXCEPTION(PollerCreateError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+	// timeouts on waits require IORING_FEAT_EXT_ARG (Linux 5.11)
+	if (!(params.features & IORING_FEAT_EXT_ARG)) {
+		close(fd);
+		BOOST_THROW_EXCEPTION(PollerCreateError() <<
+			boost::errinfo_errno(ENOSYS)
+		);
+	}
+	sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	cqMap = mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	sqes = (io_uring_sqe*)mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if ((sqMap == MAP_FAILED) || (cqMap == MAP_FAILED) || (sqes == MAP_FAILED)) {
+		int err = errno;
+		if (sqMap != MAP_FAILED) {
+			munmap(sqMap, sqMapSize);
+		}
+		if (cqMap != MAP_FAILED) {
+			munmap(cqMap, cqMapSize);
+		}
+		if (sqes != MAP_FAILED) {
+			munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+		}
+		close(fd);
+		BOOST_THROW_EXCEPTION(PollerCreateError() <<
+			boost::errinfo_errno(err)
+		);
+	}
+	char *sq = (char*)sqMap;
+	sqTail = (unsigned*)(sq + params.sq_off.tail);
+	sqArray = (unsigned*)(sq + params.sq_off.array);
+	sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	char *cq = (char*)cqMap;
+	cqHead = (unsigned*)(cq + params.cq_off.head);
+	cqTail = (unsigned*)(cq + params.cq_off.tail);
+	cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	// each submission slot always uses the entry with the same index
+	for (unsigned i = 0; i <= sqMask; ++i) {
+		sqArray[i] = i;
+	}
+	// room for a renewal of every completion so that waiting never allocates
+	renew.reserve(cqMask + 1);
+	const std::size_t readArea = readBuffers * readSize;
+	const std::size_t writeArea = writeBuffers * writeSize;
+	buffers = (char*)mmap(nullptr, readArea + writeArea,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+		-1, 0);
+	if (buffers == MAP_FAILED) {
+		int err = errno;
+		munmap(sqes, (sqMask + 1) * sizeof(io_uring_sqe));
+		munmap(cqMap, cqMapSize);
+		munmap(sqMap, sqMapSize);
+		close(fd);
+		BOOST_THROW_EXCEPTION(PollerCreateError() <<
+			boost::errinfo_errno(err)
+		);
+	}
+	iovec iov[2] = {
+		{ buffers, readArea },
+		{ buffers + readArea, writeArea }
+	};
+	fixed = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+		iov, 2) == 0;
+	for (unsigned i = 0; i < readBuffers; ++i) {
+		reading[i] = 0;
+		reader[i] = -1;
+	}
+}
+
+Poller::Ring::~Ring() {
+	munmap(sqes, (sqMask + 1) * sizeof(io_uring_sqe));
+	munmap(cqMap, cqMapSize);
+	munmap(sqMap, sqMapSize);
+	// closing the ring cancels the outstanding reads
+	close(fd);
+	munmap(buffers, readBuffers * readSize + writeBuffers * writeSize);
+}
+
+int Poller::Ring::enter(
+	unsigned waitFor,
+	unsigned flags,
+	const void *arg,
+	std::size_t argSize
+) {
+	int result = syscall(__NR_io_uring_enter, fd, pending, waitFor, flags,
+		arg, argSize);
+	if (result > 0) {
+		pending -= result;
+	}
+	return result;
+}
+
+io_uring_sqe *Poller::Ring::sqe(unsigned room) {
+	if (pending + room > sqMask + 1) {
+		if (enter(0, 0, nullptr, 0) < 0) {
+			BOOST_THROW_EXCEPTION(PollerError() <<
+				boost::errinfo_errno(errno)
+			);
+		}
+	}
+	unsigned tail = *sqTail;
+	io_uring_sqe *e = &sqes[tail & sqMask];
+	std::memset(e, 0, sizeof(io_uring_sqe));
+	// without a kernel polling thread, entries are only read during
+	// io_uring_enter(), so the caller may fill in the entry afterwards
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+	++pending;
+	return e;
+}
+
+void Poller::Ring::arm(int f, const Watch &w) {
+	io_uring_sqe *e = sqe((w.buffer < 0) ? 1 : 2);
+	e->fd = f;
+	e->user_data = userData(f, w.gen);
+	if (w.buffer < 0) {
+		e->opcode = IORING_OP_POLL_ADD;
+		e->poll32_events = w.events;
+		return;
+	}
+	// devices like evdev lack support for non-blocking reads by io_uring, so
+	// a read of a non-blocking descriptor without data completes with
+	// EAGAIN rather than waiting; a linked poll makes the read wait for data
+	e->opcode = IORING_OP_POLL_ADD;
+	e->poll32_events = EPOLLIN;
+	e->flags = IOSQE_IO_LINK;
+	e->user_data |= pollTag;
+	e = sqe(1);
+	e->fd = f;
+	e->user_data = userData(f, w.gen);
+	e->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	e->addr = (std::uint64_t)(std::uintptr_t)(buffers + w.buffer * readSize);
+	e->len = readSize;
+	// the current position; devices have none
+	e->off = (std::uint64_t)-1;
+	e->buf_index = 0;
+	reading[w.buffer] = e->user_data;
+}
+
+bool Poller::Ring::add(int f, std::uint32_t events, bool read) {
+	Watch &w = watches[f];
+	w.gen = nextGen;
+	nextGen = (nextGen + 1) & 0x3FFFFFFF;
+	if (!nextGen) {
+		nextGen = 1;
+	}
+	w.events = events;
+	w.buffer = -1;
+	for (unsigned i = 0; read && (i < readBuffers); ++i) {
+		if ((reader[i] < 0) && !reading[i]) {
+			w.buffer = i;
+			reader[i] = f;
+			break;
+		}
+	}
+	arm(f, w);
+	if (enter(0, 0, nullptr, 0) < 0) {
+		int err = errno;
+		if (w.buffer >= 0) {
+			reader[w.buffer] = -1;
+			reading[w.buffer] = 0;
+		}
+		watches.erase(f);
+		BOOST_THROW_EXCEPTION(PollerError() <<
+			boost::errinfo_errno(err)
+		);
+	}
+	return w.buffer >= 0;
+}
+
+void Poller::Ring::remove(int f) {
+	std::map<int, Watch>::iterator iter = watches.find(f);
+	if (iter == watches.end()) {
+		return;
+	}
+	int buffer = iter->second.buffer;
+	std::uint64_t ud = userData(f, iter->second.gen);
+	watches.erase(iter);
+	if (buffer >= 0) {
+		// the buffer is reused once the read completes
+		reader[buffer] = -1;
+		if (reading[buffer] != ud) {
+			return;
+		}
+	}
+	io_uring_sqe *e = sqe((buffer < 0) ? 1 : 2);
+	e->opcode = IORING_OP_POLL_REMOVE;
+	// the completion is ignored since generation zero is never watched
+	e->user_data = userData(f, 0);
+	if (buffer < 0) {
+		e->addr = ud;
+	} else {
+		// removing the linked poll cancels a read still waiting on it; a read
+		// already started is cancelled directly
+		e->addr = pollTag | ud;
+		e = sqe(1);
+		e->opcode = IORING_OP_ASYNC_CANCEL;
+		e->addr = ud;
+		e->user_data = userData(f, 0);
+	}
+	// the file descriptor may be closed soon after returning
+	if (enter(0, 0, nullptr, 0) < 0) {
+		BOOST_THROW_EXCEPTION(PollerError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+}
+
+void Poller::Ring::wait(
+	std::chrono::milliseconds timeout,
+	const std::map<int, PollResponseShared> &things,
+	ResponseRecords &responders
+) {
+	std::chrono::steady_clock::time_point end =
+		std::chrono::steady_clock::now() + timeout;
+	__kernel_timespec ts;
+	io_uring_getevents_arg arg;
+	do {
+		// renew requests for the responses called by the last wait, and for
+		// reads that completed without data during this wait; done now
+		// rather than before the responses so that data they read does not
+		// cause another completion
+		rearm();
+		std::memset(&arg, 0, sizeof(arg));
+		if (timeout.count() >= 0) {
+			ts.tv_sec = timeout.count() / 1000;
+			ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+			arg.ts = (std::uint64_t)(std::uintptr_t)&ts;
+		}
+		// queued writes normally complete while submitted; wait for one
+		// completion beyond them so that they do not end the wait
+		if (
+			(enter(1 + __builtin_popcount(writing),
+			IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+			sizeof(arg)) < 0)
+		) {
+			if ((errno == ETIME) || (errno == EINTR)) {
+				timeout = std::chrono::milliseconds(0);
+			} else {
+				BOOST_THROW_EXCEPTION(PollerError() <<
+					boost::errinfo_errno(errno)
+				);
+			}
+		}
+		unsigned head = *cqHead;
+		unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			const io_uring_cqe &c = cqes[head & cqMask];
+			if (c.user_data & pollTag) {
+				// the linked read completes next
+				continue;
+			}
+			if (c.user_data & writeTag) {
+				writing &= ~(1U << (c.user_data & (writeBuffers - 1)));
+				if (c.res < 0) {
+					++writeErrors;
+				}
+				continue;
+			}
+			// a completed read frees its buffer if the descriptor was removed
+			int buffer = -1;
+			for (unsigned i = 0; i < readBuffers; ++i) {
+				if (reading[i] == c.user_data) {
+					reading[i] = 0;
+					buffer = i;
+					break;
+				}
+			}
+			int f = (int)(std::uint32_t)c.user_data;
+			std::uint32_t gen = (std::uint32_t)(c.user_data >> 32);
+			std::map<int, Watch>::const_iterator iter = watches.find(f);
+			// removed, or from a previous addition of the same descriptor?
+			if ((iter == watches.end()) || (iter->second.gen != gen)) {
+				continue;
+			}
+			std::map<int, PollResponseShared>::const_iterator thing =
+				things.find(f);
+			if (buffer < 0) {
+				if (c.res < 0) {
+					// a bad descriptor would fail again; drop it from the ring
+					// but leave the responder for the owner to remove
+					watches.erase(f);
+					continue;
+				}
+				renew.emplace_back(f, gen);
+				if (thing != things.end()) {
+					responders.emplace_back(thing->second, f);
+				}
+				continue;
+			}
+			if ((c.res == -EAGAIN) || (c.res == -EINTR)) {
+				// the data was taken before the read, or the read was
+				// interrupted; read again before waiting
+				renew.emplace_back(f, gen);
+				continue;
+			}
+			if (c.res > 0) {
+				// read again after the data is handled
+				renew.emplace_back(f, gen);
+			} else {
+				// the end of the file, or an error like a removed device; tell
+				// the responder, which should remove the descriptor
+				reader[buffer] = -1;
+				watches.erase(f);
+			}
+			if (thing != things.end()) {
+				responders.emplace_back(thing->second, f,
+					buffers + buffer * readSize, c.res);
+			}
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		// completions of writes and removals have no responses, so wait
+		// again for the remaining time
+		if (responders.empty() && (timeout.count() > 0)) {
+			timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+				end - std::chrono::steady_clock::now()
+			);
+			if (timeout.count() <= 0) {
+				break;
+			}
+		}
+	} while (responders.empty() && timeout.count());
+}
+
+void Poller::Ring::rearm() {
+	for (const std::pair<int, std::uint32_t> &r : renew) {
+		std::map<int, Watch>::const_iterator iter = watches.find(r.first);
+		if ((iter != watches.end()) && (iter->second.gen == r.second)) {
+			arm(r.first, iter->second);
+		}
+	}
+	renew.clear();
+}
+
+bool Poller::Ring::write(int f, const void *data, std::size_t size) {
+	if ((size > writeSize) || !~writing) {
+		return false;
+	}
+	unsigned i = __builtin_ctz(~writing);
+	char *buf = buffers + readBuffers * readSize + i * writeSize;
+	std::memcpy(buf, data, size);
+	writing |= 1U << i;
+	io_uring_sqe *e = sqe();
+	// no link to the previous write is needed for ordering since writes to
+	// a non-blocking descriptor are made in order during io_uring_enter()
+	e->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	e->fd = f;
+	e->addr = (std::uint64_t)(std::uintptr_t)buf;
+	e->len = size;
+	e->off = (std::uint64_t)-1;
+	e->buf_index = 1;
+	e->user_data = writeTag | i;
+	return true;
+}
+
+void Poller::Ring::submit() {
+	if (pending && (enter(0, 0, nullptr, 0) < 0)) {
+		BOOST_THROW_EXCEPTION(PollerError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+}
+
+Poller::Poller(Backend b) : epfd(-1) {
+	if (b == Uring) {
+		try {
+			ring.reset(new Ring);
+			return;
+		} catch (PollerCreateError &) {
+			// use epoll instead
+		}
+	}
 	epfd = epoll_create(1);
 	if (epfd < 0) {
 		BOOST_THROW_EXCEPTION(PollerCreateError() <<
@@ -24,11 +611,18 @@ Poller::Poller() {
 
 Poller::~Poller() {
 	std::lock_guard<std::mutex> lock(block);
-	close(epfd);
+	if (epfd >= 0) {
+		close(epfd);
+	}
 }
 
 void Poller::add(const PollResponseShared &prs, int fd, int events) {
 	std::lock_guard<std::mutex> lock(block);
+	if (ring) {
+		ring->add(fd, events, false);
+		things[fd] = prs;
+		return;
+	}
 	epoll_event event;
 	event.events = events;
 	event.data.fd = fd;
@@ -40,6 +634,41 @@ void Poller::add(const PollResponseShared &prs, int fd, int events) {
 	things[fd] = prs;
 }
 
+void Poller::addReader(const PollResponseShared &prs, int fd) {
+	if (!ring) {
+		add(prs, fd);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(block);
+	ring->add(fd, EPOLLIN, true);
+	things[fd] = prs;
+}
+
+bool Poller::queueWrite(int fd, const void *data, std::size_t size) {
+	if (!ring) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(block);
+	if (ring->write(fd, data, size)) {
+		return true;
+	}
+	// the caller's write must follow those already queued
+	ring->submit();
+	return false;
+}
+
+void Poller::submit() {
+	std::lock_guard<std::mutex> lock(block);
+	if (ring) {
+		ring->submit();
+	}
+}
+
+std::uint64_t Poller::writeErrors() const {
+	std::lock_guard<std::mutex> lock(block);
+	return ring ? ring->writeErrors : 0;
+}
+
 PollResponseShared Poller::get(int fd) const {
 	std::lock_guard<std::mutex> lock(block);
 	std::map<int, PollResponseShared>::const_iterator iter = things.find(fd);
@@ -55,7 +684,9 @@ PollResponseShared Poller::remove(int fd) {
 	if (iter == things.end()) {
 		return PollResponseShared();
 	}
-	if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr)) {
+	if (ring) {
+		ring->remove(fd);
+	} else if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr)) {
 		BOOST_THROW_EXCEPTION(PollerError() <<
 			boost::errinfo_errno(errno)
 		);
@@ -65,33 +696,37 @@ PollResponseShared Poller::remove(int fd) {
 	return res;
 }
 
-struct ResponseRecord {
-	PollResponseShared prs;
-	int fd;
-	ResponseRecord(const PollResponseShared &p, int f) : prs(p), fd(f) { }
-};
-
 int Poller::wait(std::chrono::milliseconds timeout) {
-	std::vector<ResponseRecord> responders;
+	ResponseRecords responders;
 	{ // event responses called outside of the lock
+		// each response marks its own input path; some, like the loss of a
+		// device, are allowed to allocate
+		AllocCount::HotPath hp;
 		std::lock_guard<std::mutex> lock(block);
-		epoll_event events[32];
-		int count = epoll_wait(epfd, events, 32, timeout.count());
-		if (!count) {
-			// all done
-			return 0;
-		} else if (count < 0) {
-			BOOST_THROW_EXCEPTION(PollerError() <<
-				boost::errinfo_errno(errno)
-			);
-		}
-		responders.reserve(count);
-		for (int loop = 0; loop < count; ++loop) {
-			int fd = events[loop].data.fd;
-			std::map<int, PollResponseShared>::const_iterator iter =
-				things.find(fd);
-			if (iter != things.end()) {
-				responders.emplace_back(iter->second, fd);
+		if (ring) {
+			ring->wait(timeout, things, responders);
+			if (responders.empty()) {
+				return 0;
+			}
+		} else {
+			epoll_event events[32];
+			int count = epoll_wait(epfd, events, 32, timeout.count());
+			if (!count || ((count < 0) && (errno == EINTR))) {
+				// all done, or interrupted by a signal handler; either way,
+				// nothing to handle
+				return 0;
+			} else if (count < 0) {
+				BOOST_THROW_EXCEPTION(PollerError() <<
+					boost::errinfo_errno(errno)
+				);
+			}
+			for (int loop = 0; loop < count; ++loop) {
+				int fd = events[loop].data.fd;
+				std::map<int, PollResponseShared>::const_iterator iter =
+					things.find(fd);
+				if (iter != things.end()) {
+					responders.emplace_back(iter->second, fd);
+				}
 			}
 		}
 	}
@@ -99,7 +734,11 @@ int Poller::wait(std::chrono::milliseconds timeout) {
 		responders.begin(),
 		responders.end(),
 		[](const ResponseRecord &rr) {
-			rr.prs->respond(rr.fd);
+			if (rr.data) {
+				rr.prs->received(rr.fd, rr.data, rr.size);
+			} else {
+				rr.prs->respond(rr.fd);
+			}
 		}
 	);
 	return responders.size();
@@ -16,6 +16,7 @@
 #include <boost/exception/info.hpp>
 #include <boost/noncopyable.hpp>
 #include <mutex>
+#include <cstdint>
 #include <map>
 #include <memory>
 
@@ -39,6 +40,17 @@ public:
 	 * @param fd  The file descriptor with an event.
 	 */
 	virtual void respond(int fd) = 0;
+	/**
+	 * Called by Poller::wait(std::chrono::milliseconds) with data read by
+	 * io_uring from a file descriptor given to Poller::addReader(). Called
+	 * instead of respond() for such descriptors. Does nothing by default.
+	 * @param fd    The file descriptor that was read.
+	 * @param data  The data read. It is only valid until the function
+	 *              returns.
+	 * @param size  The number of bytes read, or a negated error number. If
+	 *              not positive, the file descriptor is no longer read.
+	 */
+	virtual void received(int fd, const void *data, int size) { }
 };
 
 typedef std::shared_ptr<PollResponse>  PollResponseShared;
@@ -48,6 +60,15 @@ typedef std::shared_ptr<PollResponse>  PollResponseShared;
  * This class is thread-safe, but is intended for handling events on one
  * thread at a time.
  *
+ * Readiness may be found with either epoll or io_uring. With io_uring, each
+ * file descriptor has a one-shot poll request that is renewed, after its
+ * response is called, as part of the same system call that waits for the
+ * next events. This behaves like level-triggered epoll while needing no
+ * separate system calls to change what is watched. File descriptors given to
+ * addReader() instead have a read outstanding into a buffer registered with
+ * the kernel, and writes given to queueWrite() are submitted by the next
+ * wait, so that handling input needs one system call per wakeup.
+ *
  * File descriptors are not managed by this class. They must be usable if given
  * to add(). Once give to add(), file descriptors must not be closed until
  * after given to remove(), or the Poller has been destructed. The Poller does
@@ -60,6 +81,19 @@ typedef std::shared_ptr<PollResponse>  PollResponseShared;
  * @author  Jeff Jackowski
  */
 class Poller : boost::noncopyable {
+public:
+	/**
+	 * The kernel facilities that may be used to wait on events.
+	 */
+	enum Backend {
+		Epoll,
+		Uring
+	};
+private:
+	/**
+	 * The io_uring state; defined in Poller.cpp.
+	 */
+	struct Ring;
 	/**
 	 * Holds responders keyed by their file descriptor.
 	 */
@@ -69,12 +103,28 @@ class Poller : boost::noncopyable {
 	 */
 	mutable std::mutex block;
 	/**
-	 * The file descriptor provided by epoll_create().
+	 * The file descriptor provided by epoll_create(), or -1 if io_uring is
+	 * in use.
 	 */
 	int epfd;
+	/**
+	 * The io_uring in use, if any.
+	 */
+	std::unique_ptr<Ring> ring;
 public:
-	Poller();
+	/**
+	 * @param b  The preferred backend. If io_uring is requested but is not
+	 *           supported by the kernel, or is not permitted, epoll is used.
+	 * @throw PollerCreateError  The poller could not be made.
+	 */
+	Poller(Backend b = Epoll);
 	~Poller();
+	/**
+	 * The backend in use.
+	 */
+	Backend backend() const {
+		return ring ? Uring : Epoll;
+	}
 	/**
 	 * Adds a file descriptor to check for events.
 	 * @pre           The file descriptor is not already added to this poller.
@@ -88,6 +138,47 @@ public:
 	 *           waiting on events to occur.
 	 */
 	void add(const PollResponseShared &prs, int fd, int events = EPOLLIN);
+	/**
+	 * Adds a file descriptor to read from. With io_uring, a read is kept
+	 * outstanding on the descriptor, and the data is given to
+	 * PollResponse::received() so that no system call beyond the wait is
+	 * needed to get it. The descriptor should be non-blocking; the kernel
+	 * then reads it when it becomes readable rather than tying up one of its
+	 * worker threads. With epoll, or if all of the 16 read buffers are in use,
+	 * this is the same as add(prs, fd) and PollResponse::respond() is called
+	 * instead.
+	 * @pre           The file descriptor is not already added to this poller.
+	 * @param prs     The object that will be given the data.
+	 * @param fd      The file descriptor.
+	 * @warning  This function will block if wait(std::chrono::milliseconds) is
+	 *           waiting on events to occur.
+	 */
+	void addReader(const PollResponseShared &prs, int fd);
+	/**
+	 * Copies data to write to a file descriptor when the next wait submits
+	 * its requests, or sooner if the submission ring fills. Writes are made
+	 * in the order they are queued. The descriptor should be non-blocking so
+	 * that the kernel makes the write during the wait. Intended for use by
+	 * the thread that calls wait(std::chrono::milliseconds) while it handles
+	 * events. Failures are counted by writeErrors().
+	 * @param fd    The file descriptor.
+	 * @param data  The data to write.
+	 * @param size  The number of bytes to write; at most 512.
+	 * @return  True if the write was queued. If false, the caller must write
+	 *          the data itself. This occurs when io_uring is not in use, or
+	 *          the data is too large, or all of the 32 write buffers are in
+	 *          use; any writes already queued are submitted first.
+	 */
+	bool queueWrite(int fd, const void *data, std::size_t size);
+	/**
+	 * Submits queued writes without waiting. Call before closing a file
+	 * descriptor given to queueWrite().
+	 */
+	void submit();
+	/**
+	 * The number of writes queued by queueWrite() that failed.
+	 */
+	std::uint64_t writeErrors() const;
 	/**
 	 * Returns the PollResponseShared object associated with the given file
 	 * descriptor by a previous call to add().
@@ -101,7 +192,9 @@ public:
 	PollResponseShared get(int fd) const;
 	/**
 	 * Removes the entry for the given file descriptor, along with the
-	 * associated PollResponseShared object.
+	 * associated PollResponseShared object. Data read by io_uring for a
+	 * descriptor given to addReader() that has not yet been given to
+	 * PollResponse::received() is discarded.
 	 * @param fd      The file descriptor.
 	 * @warning  This function will block if wait(std::chrono::milliseconds) is
 	 *           waiting on events to occur.
@@ -127,8 +220,9 @@ public:
 	 * the PollResponse::respond() functions. This means that calls to add()
 	 * and remove() do not affect the processing of the locally recorded events.
 	 *
-	 * The PollResponse::respond() functions are called in the order that the
-	 * associated events were reported by epoll_wait().
+	 * The PollResponse::respond() and PollResponse::received() functions
+	 * are called in the order that the associated events were reported by
+	 * the kernel.
 	 *
 	 * @param timeout  The maximum amount of time to wait for events to occur.
 	 *                 The function will begin processing events as soon as they
@@ -136,7 +230,7 @@ public:
 	 *                 zero will handle events that are already queued without
 	 *                 waiting for more. A value of -1 will wait indefinitely.
 	 * @return   The number of events handled. If zero, the function waited the
-	 *           maximum amount of time.
+	 *           maximum amount of time, or was interrupted by a signal.
 	 */
 	int wait(std::chrono::milliseconds timeout);
 	/**
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "RegionMap.hpp"
+#include <cstring>
+
+RegionMap::RegionMap() : minX(0), minY(0), scaleX(0), scaleY(0), blank(true) {
+	std::memset(grid, 0, sizeof(grid));
+}
+
+void RegionMap::build(
+	const std::vector<Region> &regions,
+	const input_absinfo &inX,
+	const input_absinfo &inY,
+	const Transform &xf
+) {
+	std::memset(grid, 0, sizeof(grid));
+	minX = inX.minimum;
+	minY = inY.minimum;
+	std::int64_t rangeX = (std::int64_t)inX.maximum - inX.minimum + 1;
+	std::int64_t rangeY = (std::int64_t)inY.maximum - inY.minimum + 1;
+	scaleX = ((std::int64_t)cells << 16) / rangeX;
+	scaleY = ((std::int64_t)cells << 16) / rangeY;
+	blank = regions.empty();
+	if (blank) {
+		return;
+	}
+	int count = regions.size() < maxRegions ? (int)regions.size() : maxRegions;
+	const input_absinfo &outX = xf.xInfo();
+	const input_absinfo &outY = xf.yInfo();
+	double outW = (double)outX.maximum - outX.minimum;
+	double outH = (double)outY.maximum - outY.minimum;
+	for (int cy = 0; cy < cells; ++cy) {
+		for (int cx = 0; cx < cells; ++cx) {
+			// the center of the cell in output coordinates, as a fraction of
+			// the output's size
+			int x = (int)(minX + ((2 * cx + 1) * rangeX) / (2 * cells));
+			int y = (int)(minY + ((2 * cy + 1) * rangeY) / (2 * cells));
+			xf.apply(x, y);
+			double fx = outW > 0 ? (x - outX.minimum) / outW : 0;
+			double fy = outH > 0 ? (y - outY.minimum) / outH : 0;
+			for (int r = 0; r < count; ++r) {
+				if (regions[r].contains(fx, fy)) {
+					grid[cy * cells + cx] = (std::uint8_t)(r + 1);
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef REGIONMAP_HPP
+#define REGIONMAP_HPP
+
+#include "Chord.hpp"
+#include "Transform.hpp"
+#include <vector>
+
+/**
+ * A rectangular part of the screen with its own response to touch. The
+ * edges are fractions of the output's width and height, from 0 to 1, after
+ * calibration and rotation, so a region on the left edge stays on the left
+ * edge of the display however the touchscreen is mounted.
+ */
+struct Region {
+	/**
+	 * What happens to a gesture that starts in the region.
+	 */
+	enum Action : std::uint8_t {
+		/**
+		 * The usual gestures; useful to keep part of a larger region normal.
+		 */
+		Gestures,
+		/**
+		 * Nothing; for dead zones under a bezel.
+		 */
+		Ignore,
+		/**
+		 * The left button is held while touching, and the cursor follows the
+		 * contacts, like a plain touchscreen.
+		 */
+		Click,
+		/**
+		 * @a chord is sent once the contacts move, as for an edge swipe; the
+		 * rest of the gesture is ignored.
+		 */
+		Key
+	};
+	double left;
+	double top;
+	double right;
+	double bottom;
+	/**
+	 * The keys sent by the Key action.
+	 */
+	Chord chord;
+	Action action;
+	bool operator == (const Region &r) const {
+		return (left == r.left) && (top == r.top) && (right == r.right) &&
+		(bottom == r.bottom) && (chord == r.chord) && (action == r.action);
+	}
+	bool contains(double x, double y) const {
+		return (x >= left) && (x <= right) && (y >= top) && (y <= bottom);
+	}
+};
+
+/**
+ * Finds the Region at a touchscreen location in constant time. A coarse grid
+ * over the touchscreen's coordinate range is filled in ahead of time with the
+ * first region containing the center of each cell, so a lookup is just an
+ * index computation regardless of the number of regions. Region edges are
+ * resolved to the nearest cell, which is 1/64 of the touchscreen's width and
+ * height.
+ * @author  Jeff Jackowski
+ */
+class RegionMap {
+public:
+	/**
+	 * The number of cells along each axis.
+	 */
+	static constexpr int cells = 64;
+	/**
+	 * The most regions that can be mapped.
+	 */
+	static constexpr int maxRegions = 255;
+private:
+	/**
+	 * The region index plus one for each cell, or zero for no region.
+	 */
+	std::uint8_t grid[cells * cells];
+	/**
+	 * The touchscreen's minimum coordinates.
+	 */
+	int minX;
+	int minY;
+	/**
+	 * Converts an offset from the minimum coordinate into a cell index with
+	 * 16 fractional bits.
+	 */
+	std::int64_t scaleX;
+	std::int64_t scaleY;
+	/**
+	 * True if no cell has a region.
+	 */
+	bool blank;
+public:
+	/**
+	 * Makes a map without regions.
+	 */
+	RegionMap();
+	/**
+	 * Fills in the grid.
+	 * @param regions  The regions; earlier ones take precedence where they
+	 *                 overlap. Only the first maxRegions are used.
+	 * @param inX      The range of the touchscreen's X axis.
+	 * @param inY      The range of the touchscreen's Y axis.
+	 * @param xf       The transformation from touchscreen coordinates to
+	 *                 output coordinates.
+	 */
+	void build(
+		const std::vector<Region> &regions,
+		const input_absinfo &inX,
+		const input_absinfo &inY,
+		const Transform &xf
+	);
+	/**
+	 * True if no location is in a region.
+	 */
+	bool empty() const {
+		return blank;
+	}
+	/**
+	 * Finds the region at a location in touchscreen coordinates.
+	 * @return  The index of the region, or -1 for none.
+	 */
+	int find(int x, int y) const {
+		int cx = (int)(((std::int64_t)(x - minX) * scaleX) >> 16);
+		int cy = (int)(((std::int64_t)(y - minY) * scaleY) >> 16);
+		cx = cx < 0 ? 0 : (cx >= cells ? cells - 1 : cx);
+		cy = cy < 0 ? 0 : (cy >= cells ? cells - 1 : cy);
+		return (int)grid[cy * cells + cx] - 1;
+	}
+};
+
+#endif        //  #ifndef REGIONMAP_HPP
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "SocketSink.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+SocketSink::SocketSink(const std::string &path) : drops(0) {
+	sockaddr_un addr = { };
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		BOOST_THROW_EXCEPTION(SocketSinkConnectError() <<
+			boost::errinfo_errno(ENAMETOOLONG) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	std::strcpy(addr.sun_path, path.c_str());
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		BOOST_THROW_EXCEPTION(SocketSinkConnectError() <<
+			boost::errinfo_errno(errno) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	if (connect(fd, (const sockaddr*)&addr, sizeof(addr))) {
+		int err = errno;
+		close(fd);
+		BOOST_THROW_EXCEPTION(SocketSinkConnectError() <<
+			boost::errinfo_errno(err) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+}
+
+SocketSink::~SocketSink() {
+	close(fd);
+}
+
+void SocketSink::write(const input_event *events, int count) {
+	if (send(
+		fd,
+		events,
+		count * sizeof(input_event),
+		MSG_DONTWAIT | MSG_NOSIGNAL
+	) < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			++drops;
+		} else {
+			BOOST_THROW_EXCEPTION(SocketSinkError() <<
+				boost::errinfo_errno(errno)
+			);
+		}
+	}
+}
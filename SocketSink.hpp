@@ -0,0 +1,64 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef SOCKETSINK_HPP
+#define SOCKETSINK_HPP
+
+#include "Evdev.hpp"
+#include "OutputSink.hpp"
+
+struct SocketSinkError : EvdevError { };
+struct SocketSinkConnectError : SocketSinkError { };
+
+/**
+ * Sends output events to another process over a Unix domain socket. The
+ * other process must be listening on a SOCK_SEQPACKET socket before this
+ * object is made. Each frame is sent as one message of struct input_event
+ * records, so the receiver never sees a partial frame. Sending does not
+ * block; frames are discarded if the receiver falls behind far enough to
+ * fill the socket's buffer.
+ * @author  Jeff Jackowski
+ */
+class SocketSink : boost::noncopyable, public OutputSink {
+	/**
+	 * The connected socket.
+	 */
+	int fd;
+	/**
+	 * Frames discarded because the receiver was not keeping up.
+	 */
+	std::uint64_t drops;
+public:
+	/**
+	 * Connects to the receiving process.
+	 * @param path  The file name of the receiver's socket.
+	 * @throw SocketSinkConnectError  The connection failed.
+	 */
+	SocketSink(const std::string &path);
+	/**
+	 * Closes the connection.
+	 */
+	virtual ~SocketSink();
+	/**
+	 * Sends a frame.
+	 * @throw SocketSinkError  The connection failed.
+	 */
+	virtual void write(const input_event *events, int count);
+	/**
+	 * The number of frames discarded because the receiver was not keeping
+	 * up.
+	 */
+	std::uint64_t dropped() const {
+		return drops;
+	}
+};
+
+#endif        //  #ifndef SOCKETSINK_HPP
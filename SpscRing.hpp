@@ -0,0 +1,96 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * A bounded lock-free queue for exactly one producer thread and one consumer
+ * thread. All storage is part of the object; nothing is allocated after
+ * construction.
+ * @tparam T  The element type. It is copied in and out of the queue.
+ * @tparam N  The capacity. It must be a power of two.
+ * @author  Jeff Jackowski
+ */
+template <class T, std::size_t N>
+class SpscRing {
+	static_assert((N & (N - 1)) == 0, "Capacity must be a power of two");
+	/**
+	 * The index of the next element to write. Only changed by the producer.
+	 * Kept on its own cache line to avoid false sharing with @a tail.
+	 */
+	alignas(64) std::atomic<std::size_t> head;
+	/**
+	 * The index of the next element to read. Only changed by the consumer.
+	 */
+	alignas(64) std::atomic<std::size_t> tail;
+	/**
+	 * The elements.
+	 */
+	alignas(64) T buffer[N];
+public:
+	SpscRing() : head(0), tail(0) { }
+	/**
+	 * Adds an element. Called only from the producer thread.
+	 * @return  False if the queue is full; the element is not added.
+	 */
+	bool push(const T &t) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		buffer[h & (N - 1)] = t;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+	/**
+	 * Provides the oldest element without removing it. Called only from the
+	 * consumer thread.
+	 * @return  A pointer to the element, or nullptr if the queue is empty.
+	 *          The element remains valid until pop() is called.
+	 */
+	const T *front() const {
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (head.load(std::memory_order_acquire) == t) {
+			return nullptr;
+		}
+		return &buffer[t & (N - 1)];
+	}
+	/**
+	 * Removes the oldest element. Called only from the consumer thread after
+	 * front() returned an element.
+	 */
+	void pop() {
+		tail.store(
+			tail.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release
+		);
+	}
+	/**
+	 * The number of elements in the queue. The result may be out of date by
+	 * the time it is used if the other thread is active.
+	 */
+	std::size_t size() const {
+		return head.load(std::memory_order_acquire) -
+			tail.load(std::memory_order_acquire);
+	}
+	bool empty() const {
+		return size() == 0;
+	}
+	static constexpr std::size_t capacity() {
+		return N;
+	}
+};
+
+#endif        //  #ifndef SPSCRING_HPP
@@ -0,0 +1,115 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "StatePublisher.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+StatePublisher::StatePublisher(const std::string &file) : path(file) {
+	// the segment is normally in a directory all users can write to, so
+	// links are not followed, and an existing file is only reused if it was
+	// made by this user
+	int fd = open(path.c_str(), O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+	if ((fd < 0) && (errno == ENOENT)) {
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW |
+			O_CLOEXEC, 0644);
+	}
+	if (fd < 0) {
+		BOOST_THROW_EXCEPTION(StatePublisherError() <<
+			boost::errinfo_errno(errno) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	struct stat st;
+	if (fstat(fd, &st)) {
+		int err = errno;
+		close(fd);
+		BOOST_THROW_EXCEPTION(StatePublisherError() <<
+			boost::errinfo_errno(err) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	// another name for the file could be a link to someone else's file
+	if (
+		!S_ISREG(st.st_mode) || (st.st_uid != geteuid()) ||
+		(st.st_nlink != 1)
+	) {
+		close(fd);
+		BOOST_THROW_EXCEPTION(StatePublisherError() <<
+			boost::errinfo_errno(EPERM) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	// the umask may have removed read access for others
+	if (fchmod(fd, 0644) || ftruncate(fd, sizeof(TouchStateSegment))) {
+		int err = errno;
+		close(fd);
+		BOOST_THROW_EXCEPTION(StatePublisherError() <<
+			boost::errinfo_errno(err) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	void *mem = mmap(
+		nullptr,
+		sizeof(TouchStateSegment),
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED,
+		fd,
+		0
+	);
+	// the mapping keeps the file in use
+	close(fd);
+	if (mem == MAP_FAILED) {
+		BOOST_THROW_EXCEPTION(StatePublisherError() <<
+			boost::errinfo_errno(errno) <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	seg = static_cast<TouchStateSegment*>(mem);
+	if (
+		(seg->magic == TouchStateSegment::magicValue) &&
+		(seg->version == TouchStateSegment::versionValue)
+	) {
+		// continue the sequence so readers never see it repeat; an odd
+		// value means the last writer stopped mid-update
+		seq = (seg->sequence.load(std::memory_order_relaxed) + 1) & ~1u;
+		seg->sequence.store(seq, std::memory_order_release);
+	} else {
+		seg->magic = 0;
+		seq = 0;
+		seg->sequence.store(1, std::memory_order_relaxed);
+		std::memset(&seg->frame, 0, sizeof(seg->frame));
+		seg->version = TouchStateSegment::versionValue;
+		seg->sequence.store(seq, std::memory_order_release);
+		// readers ignore the segment until the magic value is in place
+		std::atomic_thread_fence(std::memory_order_release);
+		seg->magic = TouchStateSegment::magicValue;
+	}
+}
+
+StatePublisher::~StatePublisher() {
+	clear();
+	munmap(seg, sizeof(TouchStateSegment));
+	unlink(path.c_str());
+}
+
+void StatePublisher::clear() {
+	TouchFrame &f = begin();
+	std::uint64_t frames = f.frames;
+	std::memset(&f, 0, sizeof(f));
+	f.frames = frames;
+	end();
+}
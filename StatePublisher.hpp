@@ -0,0 +1,82 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef STATEPUBLISHER_HPP
+#define STATEPUBLISHER_HPP
+
+#include "TouchState.hpp"
+#include <boost/exception/exception.hpp>
+#include <boost/noncopyable.hpp>
+#include <string>
+
+struct StatePublisherError : virtual std::exception, virtual boost::exception { };
+
+/**
+ * Writes the touch state to a shared memory segment for other programs to
+ * read; see TouchState.hpp. The segment is a file, normally on a tmpfs like
+ * /dev/shm, that readers map into their memory. Updates only write to the
+ * mapped memory.
+ *
+ * An existing segment in the same format is reused rather than replaced so
+ * that readers keep working when a new process takes over with Handoff.
+ * @author  Jeff Jackowski
+ */
+class StatePublisher : boost::noncopyable {
+	/**
+	 * The mapped segment.
+	 */
+	TouchStateSegment *seg;
+	/**
+	 * The segment's file name.
+	 */
+	std::string path;
+	/**
+	 * The sequence number while not updating; only this process writes it.
+	 */
+	std::uint32_t seq;
+public:
+	/**
+	 * Makes or reuses the segment. It is readable by all users. An existing
+	 * file is only reused if it is a regular file owned by the effective
+	 * user with no other names; a symbolic link is never followed.
+	 * @param file  The segment's file name.
+	 * @throw StatePublisherError  The segment could not be made or mapped,
+	 *                             or an existing file is not safe to use.
+	 */
+	StatePublisher(const std::string &file);
+	/**
+	 * Unmaps and removes the segment. Not called if the touchscreen was
+	 * handed over, so the segment remains for the new process.
+	 */
+	~StatePublisher();
+	/**
+	 * Starts an update and provides the frame to change. Must be followed
+	 * by end().
+	 */
+	TouchFrame &begin() {
+		seg->sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return seg->frame;
+	}
+	/**
+	 * Finishes an update.
+	 */
+	void end() {
+		seq += 2;
+		seg->sequence.store(seq, std::memory_order_release);
+	}
+	/**
+	 * Reports no contacts and no touchscreen.
+	 */
+	void clear();
+};
+
+#endif        //  #ifndef STATEPUBLISHER_HPP
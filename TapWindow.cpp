@@ -0,0 +1,67 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "TapWindow.hpp"
+#include <algorithm>
+#include <cstring>
+
+TapWindow::TapWindow() : taps(0), pct(0), floor(0), ceiling(0), win(0) {
+	std::memset(hist, 0, sizeof(hist));
+}
+
+void TapWindow::configure(int percentile, int floorMs, int ceilingMs) {
+	duration c = std::chrono::milliseconds(std::max(ceilingMs, 1));
+	if (c != ceiling) {
+		std::memset(hist, 0, sizeof(hist));
+		taps = 0;
+		ceiling = c;
+	}
+	floor = std::min(
+		duration(std::chrono::milliseconds(std::max(floorMs, 0))),
+		ceiling
+	);
+	pct = std::max(std::min(percentile, 100), 0);
+	update();
+}
+
+void TapWindow::retouch(duration interval) {
+	if (interval < ceiling) {
+		++hist[std::max(interval.count(), duration::rep(0)) * bins /
+			ceiling.count()];
+	}
+	if (++taps >= maxTaps) {
+		for (std::uint16_t &h : hist) {
+			h /= 2;
+		}
+		taps /= 2;
+	}
+	update();
+}
+
+void TapWindow::update() {
+	if (!pct || (taps < minTaps)) {
+		win = ceiling;
+		return;
+	}
+	int quick = 0;
+	for (std::uint16_t h : hist) {
+		quick += h;
+	}
+	// the bin holding the percentile; its end covers all times in it
+	int need = (quick * pct + 99) / 100;
+	int b = 0;
+	for (int sum = 0; (b < bins) && ((sum += hist[b]) < need); ++b) { }
+	if (!need) {
+		win = floor;
+	} else {
+		win = std::max(ceiling * (b + 1) / bins, floor);
+	}
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef TAPWINDOW_HPP
+#define TAPWINDOW_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * The time after a tap during which touching again starts a drag rather
+ * than waiting for the tap's click. A tap's click cannot be sent until this
+ * time has passed, so a shorter window makes taps respond sooner.
+ *
+ * The time between each tap and the next touch is kept in a small
+ * histogram of times shorter than the longest window. The window is the
+ * given percentile of those times, limited to a floor and ceiling, so that
+ * it covers nearly all of the user's drags and double taps while being no
+ * longer than needed. A user who never touches again quickly gets the floor.
+ * Touches that arrive after a shortened window are still counted, so the
+ * window grows back if the user starts dragging. Until enough taps have
+ * been seen, the ceiling is used.
+ * @author  Jeff Jackowski
+ */
+class TapWindow {
+public:
+	typedef std::chrono::steady_clock::duration  duration;
+	/**
+	 * The number of bins in the histogram; they evenly divide the time up to
+	 * the ceiling.
+	 */
+	static constexpr int bins = 32;
+	/**
+	 * The number of taps followed by another touch needed before the window
+	 * is shortened.
+	 */
+	static constexpr int minTaps = 16;
+	/**
+	 * When this many taps have been counted, all counts are halved so that
+	 * recent taps have more influence.
+	 */
+	static constexpr int maxTaps = 256;
+private:
+	/**
+	 * Counts of the times between a tap and the next touch that were
+	 * shorter than the ceiling.
+	 */
+	std::uint16_t hist[bins];
+	/**
+	 * The number of taps counted, including those followed by a touch after
+	 * the ceiling.
+	 */
+	int taps;
+	/**
+	 * The percentile used, or zero to always use the ceiling.
+	 */
+	int pct;
+	/**
+	 * The shortest window.
+	 */
+	duration floor;
+	/**
+	 * The longest window.
+	 */
+	duration ceiling;
+	/**
+	 * The window in use.
+	 */
+	duration win;
+	/**
+	 * Finds the window from the histogram.
+	 */
+	void update();
+public:
+	TapWindow();
+	/**
+	 * Sets the limits. The histogram is cleared if the ceiling changes since
+	 * the bins would no longer cover the same times.
+	 * @param percentile  The percentage of quick touches after a tap that the
+	 *                    window must cover, or zero to use the ceiling.
+	 * @param floorMs     The shortest window in milliseconds.
+	 * @param ceilingMs   The longest window in milliseconds.
+	 */
+	void configure(int percentile, int floorMs, int ceilingMs);
+	/**
+	 * Counts the time from the end of a tap to the next touch.
+	 */
+	void retouch(duration interval);
+	/**
+	 * The window in use.
+	 */
+	duration window() const {
+		return win;
+	}
+};
+
+#endif        //  #ifndef TAPWINDOW_HPP
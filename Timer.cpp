@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Timer.hpp"
+#include "AllocCount.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static timespec toTimespec(Timer::duration d) {
+	timespec ts;
+	std::chrono::nanoseconds ns =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(d);
+	ts.tv_sec = ns.count() / 1000000000;
+	ts.tv_nsec = ns.count() % 1000000000;
+	return ts;
+}
+
+Timer::Timer(const Handler &h) :
+handler(h), poller(nullptr), running(false), oneshot(true) {
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		BOOST_THROW_EXCEPTION(TimerCreateError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+}
+
+Timer::~Timer() {
+	close(fd);
+}
+
+void Timer::start(duration first, duration interval) {
+	itimerspec its;
+	// a zero value would disarm the timer
+	if (first <= duration::zero()) {
+		first = std::chrono::nanoseconds(1);
+	}
+	its.it_value = toTimespec(first);
+	its.it_interval = toTimespec(interval);
+	timerfd_settime(fd, 0, &its, nullptr);
+	running = true;
+	oneshot = interval == duration::zero();
+}
+
+void Timer::stop() {
+	if (running) {
+		itimerspec its = { };
+		timerfd_settime(fd, 0, &its, nullptr);
+		running = false;
+	}
+}
+
+void Timer::respond(int) {
+	// timers drive input handling, such as kinetic scrolling
+	AllocCount::HotPath hp;
+	std::uint64_t expirations;
+	// nothing to do if stopped after the expiration was queued
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+		return;
+	}
+	if (oneshot) {
+		running = false;
+	}
+	handler();
+}
+
+void Timer::usePoller(Poller &p) {
+	p.add(shared_from_this(), fd);
+	poller = &p;
+}
+
+void Timer::removeFromPoller() {
+	if (poller) {
+		poller->remove(fd);
+		poller = nullptr;
+	}
+}
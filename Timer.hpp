@@ -0,0 +1,97 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include "Poller.hpp"
+#include <chrono>
+#include <functional>
+
+struct TimerError : virtual std::exception, virtual boost::exception { };
+struct TimerCreateError : TimerError { };
+
+/**
+ * A timer that reports expirations through a Poller using Linux's timerfd.
+ * The timer does nothing, and causes no wakeups, while it is stopped, so
+ * periodic work can be scheduled only for as long as it is needed.
+ * @author  Jeff Jackowski
+ */
+class Timer :
+	boost::noncopyable,
+	public PollResponse,
+	public std::enable_shared_from_this<Timer>
+{
+public:
+	typedef std::function<void()>  Handler;
+	typedef std::chrono::steady_clock::duration  duration;
+private:
+	/**
+	 * Called from respond() when the timer expires.
+	 */
+	Handler handler;
+	/**
+	 * The file descriptor provided by timerfd_create().
+	 */
+	int fd;
+	/**
+	 * The poller given to usePoller(), if any.
+	 */
+	Poller *poller;
+	/**
+	 * True while the timer is armed.
+	 */
+	bool running;
+	/**
+	 * True if the timer disarms itself after the next expiration.
+	 */
+	bool oneshot;
+public:
+	/**
+	 * Makes a stopped timer.
+	 * @param h  The function to call each time the timer expires.
+	 * @throw TimerCreateError  timerfd_create() failed.
+	 */
+	Timer(const Handler &h);
+	~Timer();
+	/**
+	 * Arms the timer.
+	 * @param first     The time until the first expiration.
+	 * @param interval  The time between subsequent expirations. Use zero for
+	 *                  a single expiration.
+	 */
+	void start(duration first, duration interval = duration::zero());
+	/**
+	 * Disarms the timer. Expirations that have not yet been handled are
+	 * discarded.
+	 */
+	void stop();
+	/**
+	 * True if the timer is armed.
+	 */
+	bool active() const {
+		return running;
+	}
+	/**
+	 * Consumes the expiration count and calls the handler.
+	 */
+	virtual void respond(int);
+	void usePoller(Poller &p);
+	/**
+	 * Stops reporting expirations through the poller given to usePoller().
+	 * The Poller holds a reference to the timer until this is called.
+	 */
+	void removeFromPoller();
+};
+
+typedef std::shared_ptr<Timer>  TimerShared;
+
+#endif        //  #ifndef TIMER_HPP
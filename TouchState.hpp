@@ -0,0 +1,149 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef TOUCHSTATE_HPP
+#define TOUCHSTATE_HPP
+
+/**
+ * @file
+ * The layout of the shared memory segment made with --publish, and a
+ * function to read it. This header depends only on the standard library so
+ * that other programs can use it without the rest of Screentouch. A reader
+ * opens the file read-only, maps sizeof(TouchStateSegment) bytes with
+ * PROT_READ and MAP_SHARED, then calls readTouchState() as often as it likes.
+ * Readers never block the writer, and the writer makes no system calls to
+ * update the segment.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+static_assert(
+	std::atomic<std::uint32_t>::is_always_lock_free,
+	"The sequence number must be lock-free to work across processes"
+);
+
+/**
+ * The touch state as of the end of one frame of touchscreen input.
+ */
+struct TouchFrame {
+	/**
+	 * The data on one contact.
+	 */
+	struct Contact {
+		/**
+		 * The tracking ID from the touchscreen.
+		 */
+		std::int32_t tid;
+		/**
+		 * The location in output coordinates, after calibration and
+		 * rotation.
+		 */
+		std::int32_t x;
+		std::int32_t y;
+	};
+	/**
+	 * The most contacts reported.
+	 */
+	static constexpr int maxContacts = 64;
+	/**
+	 * The number of the operation in progress:
+	 * 0 none, 1-3 tap waiting to click the left, right, or middle button,
+	 * 4-6 drag with the left, right, or middle button, 7 cursor motion,
+	 * 8 vertical scroll, 9 horizontal scroll, 10 two-axis scroll, 11 pinch,
+	 * 12 rotation, 13 long press done, 14 ignored for a region or after an
+	 * edge swipe, 15 pressed in a click region, 16 waiting for an edge swipe.
+	 */
+	std::uint32_t operation;
+	/**
+	 * Non-zero if touch input is paused.
+	 */
+	std::uint32_t paused;
+	/**
+	 * A bit for each slot with a contact; only these entries of @a contact
+	 * are current. Contacts rejected as palms or ghosts are not included.
+	 */
+	std::uint64_t active;
+	/**
+	 * The time the frame was handled, in nanoseconds of CLOCK_MONOTONIC.
+	 */
+	std::int64_t time;
+	/**
+	 * The number of frames handled, which changes with each update.
+	 */
+	std::uint64_t frames;
+	/**
+	 * The cursor location in output coordinates.
+	 */
+	std::int32_t cursorX;
+	std::int32_t cursorY;
+	/**
+	 * The range of the output coordinates. All zero if no touchscreen is in
+	 * use.
+	 */
+	std::int32_t minX;
+	std::int32_t maxX;
+	std::int32_t minY;
+	std::int32_t maxY;
+	/**
+	 * The contacts indexed by slot.
+	 */
+	Contact contact[maxContacts];
+};
+
+/**
+ * The whole shared memory segment. The frame is protected by a sequence
+ * lock: the writer makes @a sequence odd before changing the frame and even
+ * again afterwards, so a reader that sees the same even number before and
+ * after copying the frame has a consistent copy.
+ */
+struct TouchStateSegment {
+	/**
+	 * The value of @a magic; "STTS" on little-endian machines.
+	 */
+	static constexpr std::uint32_t magicValue = 0x53545453;
+	/**
+	 * The value of @a version for the layout in this header.
+	 */
+	static constexpr std::uint32_t versionValue = 1;
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::atomic<std::uint32_t> sequence;
+	std::uint32_t reserved;
+	TouchFrame frame;
+};
+
+/**
+ * Copies the latest complete frame from the segment. If the writer changes
+ * the frame during the copy, the copy is retried; the writer updates once
+ * per frame of input, so a retry is rare and brief.
+ * @param seg   The mapped segment.
+ * @param copy  Receives the frame.
+ * @return      False if the segment is not in the expected format.
+ */
+inline bool readTouchState(const TouchStateSegment &seg, TouchFrame &copy) {
+	if (
+		(seg.magic != TouchStateSegment::magicValue) ||
+		(seg.version != TouchStateSegment::versionValue)
+	) {
+		return false;
+	}
+	std::uint32_t before, after;
+	do {
+		before = seg.sequence.load(std::memory_order_acquire);
+		copy = seg.frame;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = seg.sequence.load(std::memory_order_relaxed);
+	} while ((before & 1) || (before != after));
+	return true;
+}
+
+#endif        //  #ifndef TOUCHSTATE_HPP
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+/**
+ * @file
+ * Static tracepoints (USDT probes) for use with perf, bpftrace, and
+ * SystemTap. Each probe is a single no-op instruction until a tracer attaches
+ * to it, so they are always compiled in. The provider name is "screentouch":
+ * @code
+ * bpftrace -e 'usdt:./screentouch:screentouch:frame { @[arg1] = count(); }'
+ * @endcode
+ * The probes are:
+ * - @c event_read(type, code, value, sec, usec) for each event read from the
+ *   touchscreen, with the kernel's timestamp.
+ * - @c frame(time, contacts, operation, active) when a SYN_REPORT from the
+ *   touchscreen has been handled. The time is in nanoseconds from the steady
+ *   clock; @a active is the bit mask of tracked slots in use.
+ * - @c operation(time, old, new, contacts) when the translator's operation
+ *   changes. The operations use the values of MtTranslate::Operation.
+ * - @c flush(events, pipelined, queued) when a frame of output events is
+ *   given to the sink or to the writer thread.
+ *
+ * If sys/sdt.h, from SystemTap, is not available when building, or
+ * SCREENTOUCH_NO_TRACE is defined, the probes are omitted.
+ */
+
+#if !defined(SCREENTOUCH_NO_TRACE) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SCREENTOUCH_TRACE
+#endif
+#endif
+
+#ifdef SCREENTOUCH_TRACE
+#define TRACE_PROBE3(name, a, b, c) \
+	STAP_PROBE3(screentouch, name, a, b, c)
+#define TRACE_PROBE4(name, a, b, c, d) \
+	STAP_PROBE4(screentouch, name, a, b, c, d)
+#define TRACE_PROBE5(name, a, b, c, d, e) \
+	STAP_PROBE5(screentouch, name, a, b, c, d, e)
+#else
+#define TRACE_PROBE3(name, a, b, c)  do { } while (0)
+#define TRACE_PROBE4(name, a, b, c, d)  do { } while (0)
+#define TRACE_PROBE5(name, a, b, c, d, e)  do { } while (0)
+#endif
+
+#endif        //  #ifndef TRACE_HPP
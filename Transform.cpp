@@ -0,0 +1,148 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "Transform.hpp"
+#include <boost/exception/errinfo_file_name.hpp>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+/**
+ * Converts to 16.16 fixed point.
+ */
+static std::int64_t fixed(double d) {
+	return std::llround(d * 65536.0);
+}
+
+/**
+ * Provides the span of an axis, avoiding a zero result.
+ */
+static double span(const input_absinfo &ai) {
+	if (ai.maximum > ai.minimum) {
+		return ai.maximum - ai.minimum;
+	}
+	return 1;
+}
+
+Transform::Transform(
+	const input_absinfo &inX,
+	const input_absinfo &inY,
+	const Matrix &norm,
+	int width,
+	int height
+) : outX(inX), outY(inY) {
+	if (width > 0) {
+		outX = input_absinfo();
+		outX.maximum = width - 1;
+	}
+	if (height > 0) {
+		outY = input_absinfo();
+		outY.maximum = height - 1;
+	}
+	outX.value = outY.value = 0;
+	double ix = span(inX), iy = span(inY), ox = span(outX), oy = span(outY);
+	// normalize the input, apply the matrix, then scale to the output
+	double c[6] = {
+		ox * norm[0] / ix,
+		ox * norm[1] / iy,
+		outX.minimum + ox *
+			(norm[2] - norm[0] * inX.minimum / ix - norm[1] * inY.minimum / iy),
+		oy * norm[3] / ix,
+		oy * norm[4] / iy,
+		outY.minimum + oy *
+			(norm[5] - norm[3] * inX.minimum / ix - norm[4] * inY.minimum / iy)
+	};
+	for (int i = 0; i < 6; ++i) {
+		m[i] = fixed(c[i]);
+	}
+	// round to nearest rather than toward negative infinity
+	m[2] += 1 << 15;
+	m[5] += 1 << 15;
+	identity = (norm == identityMatrix()) &&
+		(inX.minimum == outX.minimum) && (inX.maximum == outX.maximum) &&
+		(inY.minimum == outY.minimum) && (inY.maximum == outY.maximum);
+}
+
+Transform::Matrix Transform::rotation(int degrees) {
+	switch (degrees) {
+		case 0:
+			return identityMatrix();
+		case 90:
+			return Matrix{ { 0, -1, 1, 1, 0, 0 } };
+		case 180:
+			return Matrix{ { -1, 0, 1, 0, -1, 1 } };
+		case 270:
+			return Matrix{ { 0, 1, 0, -1, 0, 1 } };
+	}
+	BOOST_THROW_EXCEPTION(TransformRotationError() <<
+		TransformRotation(degrees)
+	);
+}
+
+Transform::Matrix Transform::flip(bool x, bool y) {
+	return Matrix{ {
+		x ? -1.0 : 1.0, 0, x ? 1.0 : 0.0,
+		0, y ? -1.0 : 1.0, y ? 1.0 : 0.0
+	} };
+}
+
+Transform::Matrix Transform::combine(const Matrix &f, const Matrix &s) {
+	return Matrix{ {
+		s[0] * f[0] + s[1] * f[3],
+		s[0] * f[1] + s[1] * f[4],
+		s[0] * f[2] + s[1] * f[5] + s[2],
+		s[3] * f[0] + s[4] * f[3],
+		s[3] * f[1] + s[4] * f[4],
+		s[3] * f[2] + s[4] * f[5] + s[5]
+	} };
+}
+
+Transform::Matrix Transform::load(const std::string &path) {
+	std::ifstream file(path);
+	if (!file) {
+		BOOST_THROW_EXCEPTION(TransformFileError() <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	Matrix norm;
+	int count = 0;
+	std::string line;
+	while ((count < 6) && std::getline(file, line)) {
+		if (line.empty() || (line[0] == '#')) {
+			continue;
+		}
+		std::istringstream iss(line);
+		while ((count < 6) && (iss >> norm[count])) {
+			++count;
+		}
+	}
+	if (count < 6) {
+		BOOST_THROW_EXCEPTION(TransformParseError() <<
+			boost::errinfo_file_name(path)
+		);
+	}
+	return norm;
+}
+
+void Transform::save(const std::string &path, const Matrix &norm) {
+	std::ofstream file(path);
+	file << "# Screentouch calibration matrix on normalized coordinates\n" <<
+	std::setprecision(9);
+	for (int i = 0; i < 6; ++i) {
+		file << norm[i] << ((i % 3) == 2 ? '\n' : ' ');
+	}
+	if (!file) {
+		BOOST_THROW_EXCEPTION(TransformFileError() <<
+			boost::errinfo_file_name(path)
+		);
+	}
+}
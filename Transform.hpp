@@ -0,0 +1,150 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include <linux/input.h>
+#include <boost/exception/info.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+
+struct TransformError : virtual std::exception, virtual boost::exception { };
+struct TransformFileError : TransformError { };
+struct TransformParseError : TransformError { };
+struct TransformRotationError : TransformError { };
+
+typedef boost::error_info<struct Info_TransformRotation, int>
+	TransformRotation;
+
+/**
+ * A 2D affine transformation from touchscreen coordinates to output
+ * coordinates. It handles rotated and flipped mounting, calibration, and
+ * scaling to a display with a resolution that differs from the touchscreen.
+ *
+ * The transformation is specified by a matrix that works on normalized
+ * coordinates, where both axes range from 0 to 1 across the touchscreen and
+ * across the output. This is the same convention used by libinput's
+ * calibration matrix. The matrix is combined with the axis ranges into a
+ * fixed-point form when the Transform is made, so applying it costs a few
+ * integer multiplies.
+ * @author  Jeff Jackowski
+ */
+class Transform {
+public:
+	/**
+	 * The first two rows of a 3x3 matrix in row-major order; the last row is
+	 * always 0, 0, 1.
+	 */
+	typedef std::array<double, 6>  Matrix;
+private:
+	/**
+	 * Coefficients in 16.16 fixed point:
+	 * @code
+	 * x' = (m[0] * x + m[1] * y + m[2]) >> 16
+	 * y' = (m[3] * x + m[4] * y + m[5]) >> 16
+	 * @endcode
+	 */
+	std::int64_t m[6];
+	/**
+	 * The range of the output's X axis.
+	 */
+	input_absinfo outX;
+	/**
+	 * The range of the output's Y axis.
+	 */
+	input_absinfo outY;
+	/**
+	 * True if the transformation has no effect. Allows skipping the work.
+	 */
+	bool identity;
+public:
+	/**
+	 * Makes a transformation.
+	 * @param inX     The range of the touchscreen's X axis.
+	 * @param inY     The range of the touchscreen's Y axis.
+	 * @param norm    The transformation on normalized coordinates.
+	 * @param width   The output's width, or zero to use the range of @a inX.
+	 * @param height  The output's height, or zero to use the range of @a inY.
+	 */
+	Transform(
+		const input_absinfo &inX,
+		const input_absinfo &inY,
+		const Matrix &norm = identityMatrix(),
+		int width = 0,
+		int height = 0
+	);
+	/**
+	 * Transforms a location.
+	 */
+	void apply(int &x, int &y) const {
+		if (!identity) {
+			std::int64_t nx = (m[0] * x + m[1] * y + m[2]) >> 16;
+			y = (int)((m[3] * x + m[4] * y + m[5]) >> 16);
+			x = (int)nx;
+		}
+	}
+	/**
+	 * Transforms a difference between locations, like a velocity; the
+	 * translation part of the transformation does not apply.
+	 */
+	void applyVector(int &x, int &y) const {
+		if (!identity) {
+			std::int64_t nx = (m[0] * x + m[1] * y) >> 16;
+			y = (int)((m[3] * x + m[4] * y) >> 16);
+			x = (int)nx;
+		}
+	}
+	/**
+	 * The range of the output's X axis.
+	 */
+	const input_absinfo &xInfo() const {
+		return outX;
+	}
+	/**
+	 * The range of the output's Y axis.
+	 */
+	const input_absinfo &yInfo() const {
+		return outY;
+	}
+	static constexpr Matrix identityMatrix() {
+		return Matrix{ { 1, 0, 0, 0, 1, 0 } };
+	}
+	/**
+	 * Makes a matrix that rotates clockwise.
+	 * @param degrees  The rotation; must be 0, 90, 180, or 270.
+	 * @throw TransformRotationError  The rotation is not supported.
+	 */
+	static Matrix rotation(int degrees);
+	/**
+	 * Makes a matrix that mirrors either or both axes.
+	 */
+	static Matrix flip(bool x, bool y);
+	/**
+	 * Combines two matrices. The result applies @a first, then @a second.
+	 */
+	static Matrix combine(const Matrix &first, const Matrix &second);
+	/**
+	 * Reads a matrix from a file. The file holds six numbers separated by
+	 * whitespace. Lines starting with '#' are ignored.
+	 * @throw TransformFileError   The file could not be read.
+	 * @throw TransformParseError  The file does not contain six numbers.
+	 */
+	static Matrix load(const std::string &path);
+	/**
+	 * Writes a matrix to a file in the form read by load().
+	 * @throw TransformFileError  The file could not be written.
+	 */
+	static void save(const std::string &path, const Matrix &norm);
+};
+
+#endif        //  #ifndef TRANSFORM_HPP
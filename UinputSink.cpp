@@ -0,0 +1,126 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "UinputSink.hpp"
+#include <boost/exception/errinfo_errno.hpp>
+#include <linux/uinput.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+UinputSink::UinputSink(
+	const input_absinfo &absX,
+	const input_absinfo &absY,
+	const std::vector<std::uint16_t> &keys
+) {
+	outdev = libevdev_new();
+	libevdev_set_name(outdev, "Screentouch: Touch to mouse translator");
+	try {
+		addType(EV_ABS);
+		addCode(EV_ABS, ABS_X, &absX);
+		addCode(EV_ABS, ABS_Y, &absY);
+		addType(EV_REL);
+		addCode(EV_REL, REL_WHEEL);
+		addCode(EV_REL, REL_HWHEEL);
+		addCode(EV_REL, REL_WHEEL_HI_RES);
+		addCode(EV_REL, REL_HWHEEL_HI_RES);
+		addType(EV_KEY);
+		addCode(EV_KEY, BTN_LEFT);
+		addCode(EV_KEY, BTN_MIDDLE);
+		addCode(EV_KEY, BTN_RIGHT);
+		// other buttons that taps may be set to use
+		addCode(EV_KEY, BTN_SIDE);
+		addCode(EV_KEY, BTN_EXTRA);
+		addCode(EV_KEY, BTN_FORWARD);
+		addCode(EV_KEY, BTN_BACK);
+		// held during pinch and rotate gestures
+		addCode(EV_KEY, KEY_LEFTCTRL);
+		for (std::uint16_t k : keys) {
+			addCode(EV_KEY, k);
+		}
+		addType(EV_SYN);
+		addCode(EV_SYN, SYN_REPORT);
+		if (libevdev_uinput_create_from_device(
+			outdev,
+			LIBEVDEV_UINPUT_OPEN_MANAGED,
+			&uoutdev
+		)) {
+			BOOST_THROW_EXCEPTION(EvdevUInputCreateError());
+		}
+	} catch (...) {
+		libevdev_free(outdev);
+		throw;
+	}
+	fd = libevdev_uinput_get_fd(uoutdev);
+	poller = nullptr;
+}
+
+UinputSink::UinputSink(int descriptor) :
+outdev(nullptr), uoutdev(nullptr), fd(descriptor), poller(nullptr) { }
+
+UinputSink::~UinputSink() {
+	// queued writes must reach the device before it goes away
+	try {
+		usePoller(nullptr);
+	} catch (...) { }
+	if (uoutdev) {
+		libevdev_uinput_destroy(uoutdev);
+		libevdev_free(outdev);
+	} else {
+		ioctl(fd, UI_DEV_DESTROY);
+		close(fd);
+	}
+}
+
+void UinputSink::addType(int t) {
+	if (libevdev_enable_event_type(outdev, t)) {
+		BOOST_THROW_EXCEPTION(EvdevTypeAddError() <<
+			EvdevEventType(t) <<
+			EvdevEventTypeName(libevdev_event_type_get_name(t))
+		);
+	}
+}
+
+void UinputSink::addCode(int t, int c, const void *p) {
+	if (libevdev_enable_event_code(outdev, t, c, p)) {
+		BOOST_THROW_EXCEPTION(EvdevCodeAddError() <<
+			EvdevEventType(t) <<
+			EvdevEventTypeName(libevdev_event_type_get_name(t)) <<
+			EvdevEventCode(c) <<
+			EvdevEventCodeName(libevdev_event_code_get_name(t, c))
+		);
+	}
+}
+
+void UinputSink::write(const input_event *events, int count) {
+	if (poller && poller->queueWrite(fd, events, count * sizeof(input_event))) {
+		return;
+	}
+	if (::write(
+		fd,
+		events,
+		count * sizeof(input_event)
+	) < 0) {
+		BOOST_THROW_EXCEPTION(EvdevError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+}
+
+void UinputSink::usePoller(Poller *p) {
+	if (poller) {
+		poller->submit();
+	}
+	poller = p;
+	if (poller && (poller->backend() == Poller::Uring)) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+}
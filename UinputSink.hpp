@@ -0,0 +1,113 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#ifndef UINPUTSINK_HPP
+#define UINPUTSINK_HPP
+
+#include "Evdev.hpp"
+#include "OutputSink.hpp"
+#include <libevdev/libevdev-uinput.h>
+
+/**
+ * Outputs input events to a user-space input (uinput) device using libevdev.
+ * The device looks like a mouse with an absolute position, along with any
+ * keys the translator's settings may send.
+ * @author  Jeff Jackowski
+ */
+class UinputSink : boost::noncopyable, public OutputSink {
+	/**
+	 * The input device that this object will create.
+	 */
+	libevdev *outdev;
+	/**
+	 * The device to which input events will be output.
+	 */
+	libevdev_uinput *uoutdev;
+	/**
+	 * The uinput file descriptor.
+	 */
+	int fd;
+	/**
+	 * The poller that queues the writes, or nullptr to write directly.
+	 */
+	Poller *poller;
+	/**
+	 * Adds an event type to the input device.
+	 * @param t  The event type, such as EV_KEY.
+	 * @throw    EvdevTypeAddError  libevdev reported an error with the
+	 *                              add attempt.
+	 */
+	void addType(int t);
+	/**
+	 * Adds an event code to the input device.
+	 * @param t  The event type, such as EV_KEY.
+	 * @param c  The event code, such as BTN_LEFT.
+	 * @param p  A pointer to a input_absinfo struct (defined in Linux kernel
+	 *           code) if the event type is EV_ABS, otherwise it must be nullptr.
+	 *           The data in the input_absinfo struct will be copied, so it need
+	 *           not be maintained.
+	 * @throw    EvdevCodeAddError  libevdev reported an error with the
+	 *                              add attempt.
+	 */
+	void addCode(int t, int c, const void *p = nullptr);
+public:
+	/**
+	 * Makes a new input device to output input events specifically for the
+	 * screentouch project.
+	 * @param absX  The range of the output's X axis.
+	 * @param absY  The range of the output's Y axis.
+	 * @param keys  Keys to report in addition to the buttons, such as those
+	 *              sent by screen regions.
+	 * @throw EvdevUInputCreateError  The device could not be made.
+	 */
+	UinputSink(
+		const input_absinfo &absX,
+		const input_absinfo &absY,
+		const std::vector<std::uint16_t> &keys = std::vector<std::uint16_t>()
+	);
+	/**
+	 * Takes ownership of a uinput file descriptor with a device already
+	 * made, such as one handed over by another process.
+	 */
+	explicit UinputSink(int descriptor);
+	/**
+	 * Destroys the created input device.
+	 */
+	virtual ~UinputSink();
+	/**
+	 * The uinput file descriptor. The device exists as long as any copy of
+	 * the descriptor is open.
+	 */
+	int descriptor() const {
+		return fd;
+	}
+	/**
+	 * The path of the made device's event file, or nullptr if the device
+	 * was handed over by another process.
+	 */
+	const char *devnode() const {
+		return uoutdev ? libevdev_uinput_get_devnode(uoutdev) : nullptr;
+	}
+	/**
+	 * Writes the events to the device. When queued on the poller, a failure
+	 * is counted by Poller::writeErrors() instead.
+	 * @throw EvdevError  The write failed.
+	 */
+	virtual void write(const input_event *events, int count);
+	/**
+	 * Queues writes on the poller if it uses io_uring. The device file is
+	 * then made non-blocking so that the kernel writes during the poller's
+	 * wait. Writes already queued are submitted first.
+	 */
+	virtual void usePoller(Poller *p);
+};
+
+#endif        //  #ifndef UINPUTSINK_HPP
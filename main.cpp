@@ -9,24 +9,197 @@
  *
  * Copyright (C) 2018  Jeff Jackowski
  */
-#include "MtTranslate.hpp"
+#include "AllocCount.hpp"
+#include "Calibrator.hpp"
+#include "ControlServer.hpp"
+#include "Discovery.hpp"
+#include "FlightRecorder.hpp"
+#include "Handoff.hpp"
+#include "Log.hpp"
+#include "MemorySink.hpp"
+#include "SocketSink.hpp"
+#include "StatePublisher.hpp"
+#include "UinputSink.hpp"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <boost/exception/diagnostic_information.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
 #include <boost/program_options.hpp>
+#include <sys/mman.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
 
+/**
+ * Parses a list of CPU numbers and ranges, like "1,3-5", into a CPU set.
+ * @return  False if the list is malformed.
+ */
+static bool parseCpus(const std::string &list, cpu_set_t &cpus) {
+	CPU_ZERO(&cpus);
+	std::istringstream iss(list);
+	std::string item;
+	while (std::getline(iss, item, ',')) {
+		int first, last;
+		char dash;
+		std::istringstream is(item);
+		if (!(is >> first)) {
+			return false;
+		}
+		last = first;
+		if ((is >> dash) && ((dash != '-') || !(is >> last))) {
+			return false;
+		}
+		if ((first < 0) || (last < first) || (last >= CPU_SETSIZE)) {
+			return false;
+		}
+		for (; first <= last; ++first) {
+			CPU_SET(first, &cpus);
+		}
+	}
+	return CPU_COUNT(&cpus) > 0;
+}
 
-// used to log intput events for debugging
-void logEv(EventTypeCode tc, std::int32_t v) {
-	std::cout << "Got event " << tc.typeName() << ':' << tc.codeName() <<
-	" with value " << v << std::endl;
+/**
+ * Parses a screen region given as ACTION:LEFT,TOP,RIGHT,BOTTOM[:KEYS] where
+ * the edges are percentages of the screen's size and KEYS is a Chord, like
+ * KEY_LEFTMETA+KEY_D, needed only by the key action.
+ * @return  False if the region is malformed.
+ */
+static bool parseRegion(const std::string &spec, Region &r) {
+	std::istringstream iss(spec);
+	std::string action, edges, key;
+	if (
+		!std::getline(iss, action, ':') || !std::getline(iss, edges, ':')
+	) {
+		return false;
+	}
+	std::getline(iss, key);
+	if (action == "gestures") {
+		r.action = Region::Gestures;
+	} else if (action == "ignore") {
+		r.action = Region::Ignore;
+	} else if (action == "click") {
+		r.action = Region::Click;
+	} else if (action == "key") {
+		r.action = Region::Key;
+	} else {
+		return false;
+	}
+	double e[4];
+	char sep[3];
+	std::istringstream es(edges);
+	if (!(es >> e[0] >> sep[0] >> e[1] >> sep[1] >> e[2] >> sep[2] >> e[3]) ||
+	(sep[0] != ',') || (sep[1] != ',') || (sep[2] != ',') ||
+	(e[0] > e[2]) || (e[1] > e[3])) {
+		return false;
+	}
+	r.left = e[0] / 100.0;
+	r.top = e[1] / 100.0;
+	r.right = e[2] / 100.0;
+	r.bottom = e[3] / 100.0;
+	if (r.action == Region::Key) {
+		return Chord::parse(key, r.chord);
+	}
+	return key.empty();
+}
+
+/**
+ * Parses a gesture binding given as GESTURE=KEYS, like
+ * swipe3left=KEY_LEFTMETA+KEY_LEFT, into the settings.
+ * @return  False if the binding is malformed.
+ */
+static bool parseBinding(const std::string &spec, MtTranslate::Config &c) {
+	std::string::size_type eq = spec.find('=');
+	if (eq == std::string::npos) {
+		return false;
+	}
+	int g = MtTranslate::gestureNamed(spec.substr(0, eq));
+	return (g >= 0) && Chord::parse(spec.substr(eq + 1), c.bindings[g]);
+}
+
+/**
+ * Touches a chunk of stack so that later growth up to that size will not
+ * page fault.
+ */
+static void prefaultStack() {
+	volatile char stack[256 * 1024];
+	for (std::size_t i = 0; i < sizeof(stack); i += 4096) {
+		stack[i] = 0;
+	}
+}
+
+/**
+ * Limits the calling thread, and threads it makes afterwards, to the given
+ * CPUs. Failure is reported but is not fatal.
+ */
+static void pinCpus(const cpu_set_t &cpus) {
+	int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+	if (result) {
+		std::cerr << "Cannot set the CPU affinity: " << std::strerror(result) <<
+		'.' << std::endl;
+	}
+}
+
+/**
+ * Configures the process for low latency operation: locks memory, keeps the
+ * heap from being returned to the system, and uses real-time scheduling.
+ * Threads made afterwards inherit the scheduling settings. Failures are
+ * reported but are not fatal.
+ * @param prio  The SCHED_FIFO priority.
+ */
+static void realtime(int prio) {
+	// memory acquired later is locked, too, and must not be given back and
+	// then faulted in again
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+		std::cerr << "Cannot lock memory: " << std::strerror(errno) <<
+		". This requires CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK." <<
+		std::endl;
+	} else {
+		prefaultStack();
+	}
+	sched_param sp = { };
+	sp.sched_priority = prio;
+	int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+	if (result) {
+		std::cerr << "Cannot use real-time scheduling: " <<
+		std::strerror(result) << ". This requires CAP_SYS_NICE or a"
+		" sufficient RLIMIT_RTPRIO." << std::endl;
+	}
 }
 
 int main(int argc, char *argv[])
 try {
 	std::vector<std::string> devpath;
-	int movethres;
+	MtTranslate::Config config;
 	bool abs = false;
+	bool pipeline;
+	bool uring;
+	bool hotplug;
+	bool noalloc;
+	int rtprio;
+	std::string cpulist;
+	cpu_set_t cpus;
+	int rotate;
+	std::string screen;
+	std::string calfile;
+	std::string ctlpath;
+	std::string handpath;
+	std::string takepath;
+	std::string pubpath;
+	std::vector<std::string> regions;
+	std::vector<std::string> bindings;
+	std::string output;
+	std::string recfile;
+	std::string loglevel;
+	Log::Level lvl = Log::Off;
+	int width = 0, height = 0;
+	bool calibrate;
+	Transform::Matrix norm;
 	{ // option parsing
 		boost::program_options::options_description optdesc("");
 		optdesc.add_options()
@@ -46,15 +219,235 @@ try {
 			*/
 			( // movement threshold
 				"movethres",
-				boost::program_options::value<int>(&movethres)->
+				boost::program_options::value<int>(&config.moveDist)->
 					default_value(8),
 				"The distance, in pixels, that a contact must move before it is"
 				" considered to have moved"
 			)
+			( // palm rejection by size
+				"maxmajor",
+				boost::program_options::value<int>(&config.maxMajor)->
+					default_value(0),
+				"Ignore contacts with a major axis longer than this, in the"
+				" touchscreen's units; zero to disable"
+			)
+			( // palm rejection by size
+				"maxminor",
+				boost::program_options::value<int>(&config.maxMinor)->
+					default_value(0),
+				"Ignore contacts with a minor axis longer than this, in the"
+				" touchscreen's units; zero to disable"
+			)
+			( // ghost rejection by pressure
+				"minpressure",
+				boost::program_options::value<int>(&config.minPressure)->
+					default_value(0),
+				"Ignore contacts that start with less pressure than this, in the"
+				" touchscreen's units; zero to disable"
+			)
+			( // scroll distance
+				"scrolldist",
+				boost::program_options::value<int>(&config.scrollDist)->
+					default_value(8),
+				"The distance, in pixels, that contacts must move to scroll by"
+				" one wheel detent"
+			)
+			( // pinch zoom
+				"pinchdist",
+				boost::program_options::value<int>(&config.pinchDist)->
+					default_value(32),
+				"The change in distance, in pixels, between two fingers that"
+				" zooms by one wheel detent with the control key held; zero"
+				" to disable"
+			)
+			( // long press
+				"hold",
+				boost::program_options::value<int>(&config.holdTime)->
+					default_value(0),
+				"Click the right button after a finger stays in place for the"
+				" given number of milliseconds; zero to disable"
+			)
+			( // tap window percentile
+				"tappercentile",
+				boost::program_options::value<int>(&config.tapPercentile)->
+					default_value(95),
+				"Shorten the time a tap waits for a drag to cover this"
+				" percentage of the user's quick touches after a tap; zero to"
+				" always wait the longest time"
+			)
+			( // shortest tap window
+				"tapmin",
+				boost::program_options::value<int>(&config.tapMin)->
+					default_value(80),
+				"The shortest time, in milliseconds, a tap waits for a drag"
+			)
+			( // longest tap window
+				"tapmax",
+				boost::program_options::value<int>(&config.tapMax)->
+					default_value(192),
+				"The longest time, in milliseconds, a tap waits for a drag"
+			)
+			( // flicks
+				"flickspeed",
+				boost::program_options::value<int>(&config.flickSpeed)->
+					default_value(1200),
+				"The speed, in pixels per second, that one finger must be moving"
+				" when lifted to flick; zero to disable"
+			)
+			( // screen regions
+				"region",
+				boost::program_options::value< std::vector< std::string > >(&regions),
+				"Respond differently to gestures that start in part of the"
+				" screen, given as ACTION:LEFT,TOP,RIGHT,BOTTOM with edges in"
+				" percent of the screen's size. The actions are ignore, click"
+				" for plain left-button touches, key:KEYS to send keys, like"
+				" KEY_BACK or KEY_LEFTMETA+KEY_D, when the contacts move, and"
+				" gestures. May be given more than once; the first matching"
+				" region is used"
+			)
+			( // keyboard shortcuts
+				"bind",
+				boost::program_options::value< std::vector< std::string > >(&bindings),
+				"Send keys for a gesture, given as GESTURE=KEYS like"
+				" swipe3left=KEY_LEFTMETA+KEY_LEFT. The gestures are tap4, tap5,"
+				" and swipe3, swipe4, or flick followed by up, down, left, or"
+				" right. May"
+				" be given more than once"
+			)
+			( // rotation gesture
+				"twist",
+				"Report rotating two fingers as horizontal wheel motion with"
+				" the control key held"
+			)
+			( // output destination
+				"output",
+				boost::program_options::value<std::string>(&output)->
+					default_value("uinput"),
+				"Where to send output: uinput for a mouse-like input device,"
+				" memory to discard it after translation for measurements, or"
+				" socket:PATH to send frames of input_event structs to a"
+				" SOCK_SEQPACKET socket"
+			)
+			( // io_uring
+				"uring",
+				"Wait for input using io_uring rather than epoll, if the kernel"
+				" supports it"
+			)
+			( // separate output thread
+				"pipeline",
+				"Write output events from a separate thread so that a busy"
+				" consumer cannot delay reading the touchscreen"
+			)
+			( // real-time operation
+				"realtime",
+				"Lock memory and use real-time scheduling to bound input latency"
+			)
+			( // real-time priority
+				"rtprio",
+				boost::program_options::value<int>(&rtprio)->
+					default_value(50),
+				"The SCHED_FIFO priority used with --realtime"
+			)
+			( // verify the input path does not allocate
+				"noalloc",
+				"Exit with an error if memory is allocated while handling input"
+				" after a warm-up; for checking a build against a replayed"
+				" workload"
+			)
+			( // CPU affinity
+				"cpus",
+				boost::program_options::value<std::string>(&cpulist),
+				"Run only on the listed CPUs, like 1,3-5"
+			)
+			( // rotated mounting
+				"rotate",
+				boost::program_options::value<int>(&rotate)->default_value(0),
+				"Rotate touch locations clockwise by 0, 90, 180, or 270 degrees"
+			)
+			( // mirrored X axis
+				"flipx",
+				"Mirror touch locations horizontally"
+			)
+			( // mirrored Y axis
+				"flipy",
+				"Mirror touch locations vertically"
+			)
+			( // output resolution
+				"screen",
+				boost::program_options::value<std::string>(&screen),
+				"Scale locations to a display of the given size, like 1920x1080,"
+				" rather than keeping the touchscreen's range"
+			)
+			( // calibration matrix
+				"calibration",
+				boost::program_options::value<std::string>(&calfile),
+				"Read a calibration matrix from the given file; applied before"
+				" any rotation or mirroring"
+			)
+			( // guided calibration
+				"calibrate",
+				"Touch the display's corners to make a calibration file at the"
+				" location given by --calibration, then exit"
+			)
+			( // kinetic scrolling
+				"kinetic,k",
+				"Continue scrolling with decaying speed after lifting the fingers"
+			)
+			( // runtime control
+				"control",
+				boost::program_options::value<std::string>(&ctlpath),
+				"Accept commands to query and change settings on a Unix"
+				" socket at the given location"
+			)
+			( // restart without releasing the touchscreen
+				"handoff",
+				boost::program_options::value<std::string>(&handpath),
+				"Give the touchscreen and output device to a new process that"
+				" connects to a Unix socket at the given location with"
+				" --takeover"
+			)
+			( // take the touchscreen from a running process
+				"takeover",
+				boost::program_options::value<std::string>(&takepath),
+				"Take the touchscreen, output device, and touch state from a"
+				" running process started with --handoff at the given location"
+			)
+			( // shared touch state
+				"publish",
+				boost::program_options::value<std::string>(&pubpath),
+				"Keep the current contacts, cursor location, and operation in a"
+				" shared memory file at the given location, like"
+				" /dev/shm/screentouch, for other programs to read"
+			)
+			( // diagnostic logging
+				"loglevel",
+				boost::program_options::value<std::string>(&loglevel)->
+					default_value("off"),
+				"Write diagnostic messages to stderr: off, error, info, debug"
+				" for the state after each touchscreen frame, or trace for"
+				" each touchscreen event"
+			)
+			( // flight recorder
+				"record",
+				boost::program_options::value<std::string>(&recfile)->
+					default_value("/run/screentouch.rec"),
+				"Write recent input and decisions to the given file on SIGUSR1,"
+				" the dump control command, or a crash; a crash adds .crash to"
+				" the name"
+			)
+			( // no flight recorder
+				"norecord",
+				"Do not record recent input and decisions"
+			)
+			( // follow devices as they come and go
+				"hotplug",
+				"Wait for a touchscreen to be connected, and use another if it is"
+				" disconnected, rather than exiting"
+			)
 			( // the device file(s) to use
 				"dev,d",
 				boost::program_options::value< std::vector< std::string > >(&devpath),
-				"Specify input device file(s)"
+				"Specify input device file(s) to search for a touchscreen"
 			)
 		;
 		boost::program_options::positional_options_description posoptdesc;
@@ -68,15 +461,11 @@ try {
 			vm
 		);
 		boost::program_options::notify(vm);
-		if (!vm.count("help") && devpath.empty()) {
-			std::cerr << "Input device path not provided." << std::endl;
-		}
-		if (vm.count("help") || devpath.empty()) {
+		if (vm.count("help")) {
 			std::cout << "Screentouch - makes a touchscreen act more like a touchpad.\n" <<
-			argv[0] << " [options] [device file(s)]\n" << optdesc << std::endl;
-			if (devpath.empty()) {
-				return 1;
-			}
+			argv[0] << " [options] [device file(s)]\n" <<
+			"If no device files are given, all input devices are searched.\n" <<
+			optdesc << std::endl;
 			return 0;
 		}
 		if (vm.count("abs")) {
@@ -91,47 +480,299 @@ try {
 			// needs to be merged first
 			//std::cout << "Using relative mouse movement." << std::endl;
 		}
+		if (config.scrollDist < 1) {
+			std::cerr << "The scroll distance must be at least one." <<
+			std::endl;
+			return 1;
+		}
+		config.kinetic = vm.count("kinetic") > 0;
+		config.twist = vm.count("twist") > 0;
+		if (config.holdTime < 0) {
+			std::cerr << "The hold time cannot be negative." << std::endl;
+			return 1;
+		}
+		if ((config.tapPercentile < 0) || (config.tapPercentile > 100)) {
+			std::cerr << "The tap percentile must be from 0 to 100." <<
+			std::endl;
+			return 1;
+		}
+		if ((config.tapMin < 0) || (config.tapMax < config.tapMin)) {
+			std::cerr << "The tap times cannot be negative, and the longest"
+			" cannot be less than the shortest." << std::endl;
+			return 1;
+		}
+		if (config.flickSpeed < 0) {
+			std::cerr << "The flick speed cannot be negative." << std::endl;
+			return 1;
+		}
+		if (config.pinchDist < 0) {
+			std::cerr << "The pinch distance cannot be negative." << std::endl;
+			return 1;
+		}
+		if (regions.size() > RegionMap::maxRegions) {
+			std::cerr << "At most " << RegionMap::maxRegions <<
+			" regions may be given." << std::endl;
+			return 1;
+		}
+		for (const std::string &spec : regions) {
+			Region r;
+			if (!parseRegion(spec, r)) {
+				std::cerr << "Invalid region: " << spec << std::endl;
+				return 1;
+			}
+			config.regions.push_back(r);
+		}
+		for (const std::string &spec : bindings) {
+			if (!parseBinding(spec, config)) {
+				std::cerr << "Invalid binding: " << spec << std::endl;
+				return 1;
+			}
+		}
+		pipeline = vm.count("pipeline") > 0;
+		uring = vm.count("uring") > 0;
+		if (
+			(output != "uinput") && (output != "memory") &&
+			output.compare(0, 7, "socket:")
+		) {
+			std::cerr << "Invalid output: " << output << std::endl;
+			return 1;
+		}
+		hotplug = vm.count("hotplug") > 0;
+		noalloc = vm.count("noalloc") > 0;
+		if (!Log::parse(loglevel, lvl)) {
+			std::cerr << "Invalid log level: " << loglevel << std::endl;
+			return 1;
+		}
+		if (vm.count("norecord")) {
+			recfile.clear();
+		}
+		if (!vm.count("realtime")) {
+			rtprio = 0;
+		} else if (
+			(rtprio < sched_get_priority_min(SCHED_FIFO)) ||
+			(rtprio > sched_get_priority_max(SCHED_FIFO))
+		) {
+			std::cerr << "The real-time priority must be from " <<
+			sched_get_priority_min(SCHED_FIFO) << " to " <<
+			sched_get_priority_max(SCHED_FIFO) << '.' << std::endl;
+			return 1;
+		}
+		if (
+			!screen.empty() && (
+				(std::sscanf(screen.c_str(), "%dx%d", &width, &height) != 2) ||
+				(width < 1) || (height < 1)
+			)
+		) {
+			std::cerr << "Invalid screen size: " << screen << std::endl;
+			return 1;
+		}
+		calibrate = vm.count("calibrate") > 0;
+		if (calibrate && calfile.empty()) {
+			std::cerr << "Calibration requires a file given by --calibration." <<
+			std::endl;
+			return 1;
+		}
+		if (!calibrate) try {
+			norm = Transform::combine(
+				Transform::combine(
+					calfile.empty() ? Transform::identityMatrix() :
+						Transform::load(calfile),
+					Transform::rotation(rotate)
+				),
+				Transform::flip(vm.count("flipx") > 0, vm.count("flipy") > 0)
+			);
+		} catch (TransformRotationError &) {
+			std::cerr << "The rotation must be 0, 90, 180, or 270." << std::endl;
+			return 1;
+		} catch (TransformError &) {
+			std::cerr << "Cannot read the calibration file " << calfile << '.' <<
+			std::endl;
+			return 1;
+		}
+		if (!cpulist.empty() && !parseCpus(cpulist, cpus)) {
+			std::cerr << "Invalid CPU list: " << cpulist << std::endl;
+			return 1;
+		}
 	}
-	// C++ friendly epoll
-	Poller poller;
-	for (const std::string devarg : devpath) {
-		// initialize input
-		EvdevShared evin;
-		try {
-			evin = std::make_shared<Evdev>(devarg);
-		} catch (EvdevError &) {
-			std::cerr << "Failed to open " << devarg << '.' << std::endl;
-			continue;
+	// outlasts the translators, which may be kept by objects in the poller
+	std::unique_ptr<StatePublisher> publisher;
+	// C++ friendly epoll or io_uring
+	Poller poller(uring ? Poller::Uring : Poller::Epoll);
+	if (uring && (poller.backend() != Poller::Uring)) {
+		std::cerr << "io_uring is not available; using epoll." << std::endl;
+	}
+	// the device files given by the user, if any, limit the devices used
+	std::vector<std::string> allowed(devpath);
+	{ // find likely touchscreens without opening every device
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		std::size_t considered = devpath.size();
+		devpath = discoverTouchscreens(devpath);
+		std::cout << "Device discovery took " <<
+		std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start
+		).count() << "us";
+		if (considered) {
+			std::cout << " and excluded " << considered - devpath.size() <<
+			" of " << considered << " device(s)";
 		}
-		// check for touch input
-		if (!evin->hasEventType(EV_ABS) || (evin->numSlots() < 0)) {
-			std::cerr << "Device " << devarg << ", " << evin->name() <<
-			", is not a touch screen." << std::endl;
-			continue;
+		std::cout << '.' << std::endl;
+	}
+	if (calibrate) {
+		Log::level(lvl);
+		for (const std::string &devarg : devpath) {
+			EvdevShared evin = DeviceManager::openTouchscreen(devarg, true);
+			if (!evin) {
+				continue;
+			}
+			evin->usePoller(poller);
+			Calibrator cal(*evin);
+			while (!cal.done()) {
+				poller.wait();
+			}
+			Transform::save(calfile, cal.result());
+			std::cout << "Calibration written to " << calfile << '.' <<
+			std::endl;
+			return 0;
 		}
-		std::cout << "Using device " << devarg << ", " << evin->name() << '.'
-		<< std::endl;
-		if (!evin->grab()) {
-			std::cerr << "Cannot gain exclusive access." << std::endl;
-		}
-		/*  for logging input events from the touch screen
-		evin->inputConnect(EventTypeCode(EV_ABS, ABS_MT_SLOT), &logEv);
-		evin->inputConnect(EventTypeCode(EV_ABS, ABS_MT_TRACKING_ID), &logEv);
-		evin->inputConnect(EventTypeCode(EV_ABS, ABS_MT_POSITION_X), &logEv);
-		evin->inputConnect(EventTypeCode(EV_ABS, ABS_MT_POSITION_Y), &logEv);
-		evin->inputConnect(EventTypeCode(EV_SYN, SYN_REPORT), &logEv);
-		*/
-		evin->usePoller(poller);
-		MtTranslate ms(evin, movethres);
-		do {
-			if (!poller.wait(std::chrono::milliseconds(192))) {
-				ms.timeoutHandle();
+		std::cerr << "No touchscreen found." << std::endl;
+		return 1;
+	}
+	// done before anything else is allocated so all of it is locked,
+	// and before threads are made so they inherit the settings
+	if (rtprio) {
+		realtime(rtprio);
+	}
+	if (!cpulist.empty()) {
+		pinCpus(cpus);
+	}
+	// starts the log's thread, if used
+	Log::level(lvl);
+	std::unique_ptr<FlightRecorder> recorder;
+	if (!recfile.empty()) {
+		recorder.reset(new FlightRecorder(recfile));
+		FlightRecorder::installSignalHandlers();
+	}
+	if (!pubpath.empty()) try {
+		publisher.reset(new StatePublisher(pubpath));
+	} catch (StatePublisherError &spe) {
+		const int *err = boost::get_error_info<boost::errinfo_errno>(spe);
+		std::cerr << "Cannot make the shared state file " << pubpath << ": " <<
+		std::strerror(err ? *err : EINVAL) << '.' << std::endl;
+		return 1;
+	}
+	Handoff::Taken taken;
+	taken.uinput = -1;
+	if (!takepath.empty()) try {
+		taken = Handoff::take(takepath);
+	} catch (HandoffTakeError &hte) {
+		const int *err = boost::get_error_info<boost::errinfo_errno>(hte);
+		std::cerr << "Cannot take over from " << takepath << ": " <<
+		std::strerror(err ? *err : EINVAL) << '.' << std::endl;
+		return 1;
+	}
+	DeviceManagerShared devman = std::make_shared<DeviceManager>(
+		poller,
+		[&](const EvdevShared &evin) {
+			Transform xform(
+				*evin->absInfo(ABS_MT_POSITION_X),
+				*evin->absInfo(ABS_MT_POSITION_Y),
+				norm,
+				width,
+				height
+			);
+			OutputSinkPtr sink;
+			if (output == "memory") {
+				sink.reset(new MemorySink);
+			} else if (output != "uinput") {
+				sink.reset(new SocketSink(output.substr(7)));
+			}
+			if (taken.uinput >= 0) {
+				// keep the uinput device from the old process if still wanted
+				if (!sink) {
+					sink.reset(new UinputSink(taken.uinput));
+				} else {
+					close(taken.uinput);
+				}
+				taken.uinput = -1;
+			}
+			std::unique_ptr<MtTranslate> ms(
+				MtTranslate::make(evin, xform, config, std::move(sink))
+			);
+			ms->usePoller(poller);
+			ms->publishTo(publisher.get());
+			if (pipeline) {
+				ms->output().startPipeline();
 			}
-		} while (true);
-		return 0;
+			return ms;
+		},
+		allowed,
+		config
+	);
+	if (!takepath.empty()) {
+		// the touchscreen is still grabbed by the old process's open file
+		devman->adopt(taken.device, std::make_shared<Evdev>(taken.evdev));
+		if (taken.haveSnapshot) {
+			devman->translation()->restore(taken.snapshot);
+		}
+		Handoff::complete(taken);
+	} else if (!devman->attachFirst(devpath) && !hotplug) {
+		std::cerr << "No touchscreen found." << std::endl;
+		return 1;
+	}
+	if (!ctlpath.empty()) try {
+		std::make_shared<ControlServer>(poller, devman, ctlpath)->start();
+	} catch (ControlSocketError &cse) {
+		const int *err = boost::get_error_info<boost::errinfo_errno>(cse);
+		std::cerr << "Cannot make the control socket " << ctlpath << ": " <<
+		std::strerror(err ? *err : EINVAL) << '.' << std::endl;
+		return 1;
+	}
+	if (!handpath.empty()) try {
+		std::make_shared<Handoff>(poller, devman, handpath)->start();
+	} catch (HandoffSocketError &hse) {
+		const int *err = boost::get_error_info<boost::errinfo_errno>(hse);
+		std::cerr << "Cannot make the handoff socket " << handpath << ": " <<
+		std::strerror(err ? *err : EINVAL) << '.' << std::endl;
+		return 1;
 	}
-	std::cerr << "No touchscreen found." << std::endl;
+	if (hotplug) {
+		devman->watch();
+		if (!devman->attached()) {
+			std::cout << "Waiting for a touchscreen." << std::endl;
+		}
+	}
+	// the first input may allocate things that are then kept, like the
+	// storage for signal connections, so allocations are only an error after
+	// this many wakeups have handled input
+	int warmup = 64;
+	do {
+		// wake only when input arrives or a gesture's deadline passes
+		int handled = poller.wait(devman->timeout());
+		devman->timeoutHandle();
+		if (!noalloc) {
+			continue;
+		}
+		if (warmup) {
+			if (handled && !--warmup) {
+				AllocCount::reset();
+			}
+		} else if (AllocCount::hot()) {
+			std::cerr << "Memory was allocated while handling input." <<
+			std::endl;
+			return 4;
+		}
+	} while (hotplug || devman->attached());
+	std::cerr << "No touchscreen remains." << std::endl;
 	return 1;
+} catch (SocketSinkConnectError &ssce) {
+	const int *err = boost::get_error_info<boost::errinfo_errno>(ssce);
+	const std::string *file =
+		boost::get_error_info<boost::errinfo_file_name>(ssce);
+	std::cerr << "Cannot connect to the output socket " <<
+	(file ? *file : std::string()) << ": " <<
+	std::strerror(err ? *err : EINVAL) << '.' << std::endl;
+	return 2;
 } catch (EvdevUInputCreateError &) {
 	std::cerr << "Failed to create the user input device. /dev/uinput may not exist,"
 	" or may not be readable and writeable from this user account." << std::endl;
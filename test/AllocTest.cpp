@@ -0,0 +1,445 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "../AllocCount.hpp"
+#include "../Evdev.hpp"
+#include "../MemorySink.hpp"
+#include "../MtTranslate.hpp"
+#include "../UinputSink.hpp"
+#include <boost/exception/diagnostic_information.hpp>
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * A touchscreen with no device file; its input is supplied by the workload.
+ * The input is either dispatched as it is made, or written to a pipe that
+ * is read like a device file through the poller.
+ * @author  Jeff Jackowski
+ */
+class ScriptedTouch : public Evdev {
+	/**
+	 * Makes a libevdev object with the axes of a ten slot touchscreen.
+	 */
+	static libevdev *device() {
+		libevdev *d = libevdev_new();
+		libevdev_set_name(d, "scripted touchscreen");
+		libevdev_enable_property(d, INPUT_PROP_DIRECT);
+		libevdev_enable_event_type(d, EV_SYN);
+		libevdev_enable_event_type(d, EV_ABS);
+		input_absinfo ai = { };
+		ai.maximum = 9;
+		libevdev_enable_event_code(d, EV_ABS, ABS_MT_SLOT, &ai);
+		ai.maximum = 65535;
+		libevdev_enable_event_code(d, EV_ABS, ABS_MT_TRACKING_ID, &ai);
+		ai.maximum = 799;
+		ai.resolution = 10;
+		libevdev_enable_event_code(d, EV_ABS, ABS_MT_POSITION_X, &ai);
+		libevdev_enable_event_code(d, EV_ABS, ABS_X, &ai);
+		ai.maximum = 479;
+		libevdev_enable_event_code(d, EV_ABS, ABS_MT_POSITION_Y, &ai);
+		libevdev_enable_event_code(d, EV_ABS, ABS_Y, &ai);
+		return d;
+	}
+	/**
+	 * The next tracking ID.
+	 */
+	int nextTid;
+	/**
+	 * The write end of the pipe read as the device file, or -1 to dispatch
+	 * input directly.
+	 */
+	int pipeIn;
+	/**
+	 * The frame being made for the pipe.
+	 */
+	input_event frame[64];
+	int count;
+public:
+	/**
+	 * Makes a touchscreen with input that is dispatched directly.
+	 */
+	ScriptedTouch() : Evdev(device()), nextTid(1), pipeIn(-1), count(0) { }
+	/**
+	 * Makes a touchscreen that is read from a pipe by the poller given to
+	 * usePoller(), which must use io_uring. Both ends are closed by the
+	 * destructor.
+	 * @param readEnd   The end read as the device file.
+	 * @param writeEnd  The end the input is written to.
+	 */
+	ScriptedTouch(int readEnd, int writeEnd) :
+	Evdev(device()), nextTid(1), pipeIn(writeEnd), count(0) {
+		fd = readEnd;
+	}
+	~ScriptedTouch() {
+		if (pipeIn >= 0) {
+			close(pipeIn);
+		}
+	}
+	/**
+	 * Sends one input event as though it was read from the touchscreen.
+	 */
+	void event(std::uint16_t type, std::uint16_t code, std::int32_t value) {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		input_event ie;
+		ie.input_event_sec = ts.tv_sec;
+		ie.input_event_usec = ts.tv_nsec / 1000;
+		ie.type = type;
+		ie.code = code;
+		ie.value = value;
+		if (pipeIn >= 0) {
+			frame[count++] = ie;
+			// the reads are handled by the poller
+			if ((type == EV_SYN) || (count == 64)) {
+				if (::write(pipeIn, frame, count * sizeof(input_event)) < 0) {
+					std::cerr << "Cannot write the scripted input." <<
+					std::endl;
+				}
+				count = 0;
+			}
+		} else {
+			// the same as reading input from a device
+			AllocCount::HotPath hp;
+			dispatch(ie);
+		}
+	}
+	/**
+	 * Starts a contact in the given slot.
+	 */
+	void down(int slot, int x, int y) {
+		event(EV_ABS, ABS_MT_SLOT, slot);
+		event(EV_ABS, ABS_MT_TRACKING_ID, nextTid++ & 0xFFFF);
+		event(EV_ABS, ABS_MT_POSITION_X, x);
+		event(EV_ABS, ABS_MT_POSITION_Y, y);
+	}
+	/**
+	 * Moves a contact in the given slot.
+	 */
+	void move(int slot, int x, int y) {
+		event(EV_ABS, ABS_MT_SLOT, slot);
+		event(EV_ABS, ABS_MT_POSITION_X, x);
+		event(EV_ABS, ABS_MT_POSITION_Y, y);
+	}
+	/**
+	 * Ends the contact in the given slot.
+	 */
+	void up(int slot) {
+		event(EV_ABS, ABS_MT_SLOT, slot);
+		event(EV_ABS, ABS_MT_TRACKING_ID, -1);
+	}
+	/**
+	 * Ends a frame of input, then waits the time between frames of a
+	 * typical touchscreen. Input written to the pipe is then handled.
+	 */
+	void sync() {
+		event(EV_SYN, SYN_REPORT, 0);
+		std::this_thread::sleep_for(std::chrono::milliseconds(8));
+		if (pipeIn >= 0) {
+			poller->wait(std::chrono::milliseconds(0));
+		}
+	}
+	/**
+	 * Reports that the kernel dropped input, then ends the frame. The
+	 * current state is then sent again.
+	 */
+	void drop() {
+		if (pipeIn >= 0) {
+			event(EV_SYN, SYN_DROPPED, 0);
+			event(EV_ABS, ABS_MT_SLOT, 0);
+			sync();
+		} else {
+			AllocCount::HotPath hp;
+			resync();
+		}
+	}
+};
+
+/**
+ * Handles the translator's deadlines and kinetic scrolling for the given
+ * time, like the main loop does between touches.
+ */
+static void idle(Poller &poller, MtTranslate &mt, std::chrono::milliseconds t) {
+	std::chrono::steady_clock::time_point end =
+		std::chrono::steady_clock::now() + t;
+	std::chrono::steady_clock::time_point now;
+	while ((now = std::chrono::steady_clock::now()) < end) {
+		std::chrono::milliseconds left =
+			std::chrono::duration_cast<std::chrono::milliseconds>(end - now);
+		std::chrono::milliseconds next = mt.timeout();
+		poller.wait(((next.count() < 0) || (next > left)) ? left : next);
+		AllocCount::HotPath hp;
+		mt.timeoutHandle();
+	}
+}
+
+/**
+ * Moves @a n contacts, spaced apart horizontally, by the given amount over
+ * @a frames frames.
+ */
+static void drag(ScriptedTouch &st, int n, int x, int y, int dx, int dy,
+int frames) {
+	for (int s = 0; s < n; ++s) {
+		st.down(s, x + s * 60, y);
+	}
+	st.sync();
+	for (int f = 1; f <= frames; ++f) {
+		for (int s = 0; s < n; ++s) {
+			st.move(s, x + s * 60 + dx * f / frames, y + dy * f / frames);
+		}
+		st.sync();
+	}
+	for (int s = 0; s < n; ++s) {
+		st.up(s);
+	}
+	st.sync();
+}
+
+/**
+ * Translates one pass of the workload.
+ */
+static void workload(ScriptedTouch &st, Poller &poller, MtTranslate &mt) {
+	const std::chrono::milliseconds rest(300);
+	// input dropped by the kernel between gestures
+	st.drop();
+	// tap for a left click
+	st.down(0, 400, 240);
+	st.sync();
+	st.up(0);
+	st.sync();
+	idle(poller, mt, rest);
+	// tap, then touch again to drag
+	st.down(0, 400, 240);
+	st.sync();
+	st.up(0);
+	st.sync();
+	drag(st, 1, 400, 240, 120, 60, 20);
+	idle(poller, mt, rest);
+	// move the cursor slowly, then a flick
+	drag(st, 1, 200, 200, 100, 0, 40);
+	idle(poller, mt, rest);
+	drag(st, 1, 200, 200, 160, 0, 8);
+	idle(poller, mt, rest);
+	// two contacts scrolling, lifted while moving to scroll kinetically
+	drag(st, 2, 300, 100, 0, 200, 12);
+	idle(poller, mt, rest);
+	drag(st, 2, 200, 300, 240, 0, 12);
+	idle(poller, mt, rest);
+	// pinch apart
+	st.down(0, 380, 240);
+	st.down(1, 420, 240);
+	st.sync();
+	for (int f = 1; f <= 20; ++f) {
+		st.move(0, 380 - f * 8, 240);
+		st.move(1, 420 + f * 8, 240);
+		st.sync();
+	}
+	st.up(0);
+	st.up(1);
+	st.sync();
+	idle(poller, mt, rest);
+	// rotate about the center
+	st.down(0, 300, 240);
+	st.down(1, 500, 240);
+	st.sync();
+	for (int f = 1; f <= 20; ++f) {
+		st.move(0, 300 + f * 2, 240 - f * 5);
+		st.move(1, 500 - f * 2, 240 + f * 5);
+		st.sync();
+	}
+	st.up(0);
+	st.up(1);
+	st.sync();
+	idle(poller, mt, rest);
+	// three contacts swiping left
+	drag(st, 3, 500, 200, -240, 0, 12);
+	idle(poller, mt, rest);
+}
+
+/**
+ * Counts the stored output events of the given type and code.
+ * @param value  The value to count, or -1 for any non-zero value.
+ */
+static int tally(const MemorySink &ms, int type, int code, int value) {
+	int n = 0;
+	for (std::size_t i = 0; i < ms.size(); ++i) {
+		if (
+			(ms[i].type == type) && (ms[i].code == code) &&
+			((value < 0) ? (ms[i].value != 0) : (ms[i].value == value))
+		) {
+			++n;
+		}
+	}
+	return n;
+}
+
+/**
+ * Checks that both passes of the workload made the expected output, so that
+ * a workload that silently misfires does not pass.
+ * @return  True if the output has the expected frames and gestures.
+ */
+static bool expected(const MemorySink &ms) {
+	struct {
+		const char *name;
+		int count, least;
+	} checks[] = {
+		{ "frames", tally(ms, EV_SYN, SYN_REPORT, 0), 300 },
+		// the tap and the drag
+		{ "left button presses", tally(ms, EV_KEY, BTN_LEFT, 1), 4 },
+		{ "wheel events", tally(ms, EV_REL, REL_WHEEL, -1), 10 },
+		// the pinch and the rotation
+		{ "control key presses", tally(ms, EV_KEY, KEY_LEFTCTRL, 1), 4 },
+		// the three contact swipe
+		{ "left key presses", tally(ms, EV_KEY, KEY_LEFT, 1), 2 }
+	};
+	bool good = ms.totalEvents() <= ms.capacity();
+	if (!good) {
+		std::cerr << "Too much output to check." << std::endl;
+	}
+	for (const auto &c : checks) {
+		if (c.count < c.least) {
+			std::cerr << "Expected at least " << c.least << ' ' << c.name <<
+			", but got " << c.count << '.' << std::endl;
+			good = false;
+		}
+	}
+	return good;
+}
+
+/**
+ * Translates the workload once to warm up, then again while counting
+ * allocations. With io_uring, the input is read from a pipe by the poller,
+ * and the output is queued on the poller by a UinputSink writing to another
+ * pipe, so the same path as a real touchscreen and uinput device is used.
+ * @param backend   The poller's backend, which runs the kinetic scrolling
+ *                  timer.
+ * @param pipeline  True to write the output on its own thread.
+ * @param good      Set to false if the output is not as expected.
+ * @return  The allocations made in the second pass.
+ */
+static std::uint64_t run(Poller::Backend backend, bool pipeline, bool &good) {
+	Poller poller(backend);
+	bool piped = poller.backend() == Poller::Uring;
+	int in[2] = { -1, -1 }, out[2] = { -1, -1 };
+	if (piped && (pipe2(in, O_CLOEXEC) || pipe2(out, O_CLOEXEC))) {
+		throw std::runtime_error("cannot make pipes");
+	}
+	std::shared_ptr<ScriptedTouch> st = piped ?
+		std::make_shared<ScriptedTouch>(in[0], in[1]) :
+		std::make_shared<ScriptedTouch>();
+	MtTranslate::Config cfg;
+	cfg.kinetic = true;
+	cfg.twist = true;
+	Chord::parse("KEY_LEFT", cfg.bindings[MtTranslate::Swipe3Left]);
+	Chord::parse("KEY_RIGHT", cfg.bindings[MtTranslate::FlickRight]);
+	Transform xf(
+		*st->absInfo(ABS_MT_POSITION_X),
+		*st->absInfo(ABS_MT_POSITION_Y)
+	);
+	// holds all the output of both passes
+	const std::size_t capacity = 65536;
+	MemorySink *ms;
+	std::unique_ptr<MemorySink> received;
+	std::thread reader;
+	OutputSinkPtr sink;
+	if (piped) {
+		// collects the frames written to the pipe until it is closed
+		received.reset(new MemorySink(capacity));
+		ms = received.get();
+		reader = std::thread([ms, fd = out[0]] {
+			input_event buf[128];
+			std::size_t have = 0;
+			ssize_t r;
+			while ((r = read(fd, (char*)buf + have, sizeof(buf) - have)) > 0) {
+				have += r;
+				std::size_t whole = have / sizeof(input_event);
+				ms->write(buf, (int)whole);
+				have -= whole * sizeof(input_event);
+				std::memmove(buf, buf + whole, have);
+			}
+			close(fd);
+		});
+		sink.reset(new UinputSink(out[1]));
+	} else {
+		ms = new MemorySink(capacity);
+		sink.reset(ms);
+	}
+	std::unique_ptr<MtTranslate> mt(
+		MtTranslate::make(st, xf, cfg, std::move(sink))
+	);
+	mt->usePoller(poller);
+	if (piped) {
+		st->usePoller(poller);
+	}
+	if (pipeline) {
+		mt->output().startPipeline();
+	}
+	workload(*st, poller, *mt);
+	AllocCount::reset();
+	workload(*st, poller, *mt);
+	std::uint64_t allocs = AllocCount::hot();
+	if (pipeline) {
+		mt->output().stopPipeline();
+	}
+	std::uint64_t writeErrors = poller.writeErrors();
+	if (piped) {
+		st->removeFromPoller();
+		// closes the output pipe, which ends the reader
+		mt.reset();
+		reader.join();
+	}
+	std::cout << (pipeline ? "Pipelined" : "Direct") << " output with " <<
+	(piped ? "io_uring through pipes: " : "epoll: ") <<
+	tally(*ms, EV_SYN, SYN_REPORT, 0) << " frames written, " << allocs <<
+	" allocations after warm-up." << std::endl;
+	if (writeErrors) {
+		std::cerr << writeErrors << " writes through io_uring failed." <<
+		std::endl;
+		good = false;
+	}
+	if (!expected(*ms)) {
+		good = false;
+	}
+	return allocs;
+}
+
+/**
+ * Checks that translating touch input does not allocate memory once the
+ * first input has been handled. A scripted workload of taps, drags, flicks,
+ * scrolls, pinches, rotations, and swipes is translated twice; allocations
+ * are only counted during the second pass. The program exits with a non-zero
+ * status if any are made.
+ */
+int main() try {
+	bool good = true;
+	std::uint64_t allocs = run(Poller::Epoll, false, good);
+	allocs += run(Poller::Epoll, true, good);
+	allocs += run(Poller::Uring, false, good);
+	if (allocs) {
+		std::cerr << "Memory was allocated while handling input." <<
+		std::endl;
+		return 1;
+	}
+	if (!good) {
+		std::cerr << "The output was not as expected." << std::endl;
+		return 3;
+	}
+	return 0;
+} catch (...) {
+	std::cerr << "Program failed:\n" <<
+	boost::current_exception_diagnostic_information()
+	<< std::endl;
+	return 2;
+}
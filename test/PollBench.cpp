@@ -0,0 +1,361 @@
+/*
+ * This file is part of the Screentouch project. It is subject to the GPLv3
+ * license terms in the LICENSE file found in the top-level directory of this
+ * distribution and at
+ * https://github.com/jjackowski/screentouch/blob/master/LICENSE.
+ * No part of the Screentouch project, including this file, may be copied,
+ * modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE file.
+ *
+ * Copyright (C) 2018  Jeff Jackowski
+ */
+#include "../FlightRecorder.hpp"
+#include "../MtTranslate.hpp"
+#include "../UinputSink.hpp"
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+/**
+ * A frame of recorded input to replay.
+ */
+struct Frame {
+	/**
+	 * The time from the start of the replay.
+	 */
+	std::chrono::nanoseconds when;
+	/**
+	 * The events, not including the SYN_REPORT.
+	 */
+	std::vector<input_event> events;
+};
+
+typedef std::vector<Frame>  Frames;
+
+/**
+ * Reads the input records from a flight recorder dump into frames.
+ * @return  False if the file could not be read.
+ */
+static bool load(const char *file, Frames &frames) {
+	std::ifstream in(file, std::ios::binary);
+	FlightRecorder::Header hdr;
+	if (!in.read((char*)&hdr, sizeof(hdr)) ||
+	std::memcmp(hdr.magic, "STFLTREC", sizeof(hdr.magic)) ||
+	(hdr.version != 1) || (hdr.recordSize != sizeof(FlightRecorder::Record))) {
+		return false;
+	}
+	FlightRecorder::Record r;
+	std::int64_t start = -1;
+	Frame f;
+	while (in.read((char*)&r, sizeof(r))) {
+		if (r.kind != FlightRecorder::Input) {
+			continue;
+		}
+		if (start < 0) {
+			start = r.time;
+		}
+		if ((r.type == EV_SYN) && (r.code == SYN_REPORT)) {
+			f.when = std::chrono::nanoseconds(r.time - start);
+			frames.push_back(std::move(f));
+			f.events.clear();
+		} else if (r.type == EV_ABS) {
+			input_event ie = { };
+			ie.type = r.type;
+			ie.code = r.code;
+			ie.value = r.value;
+			f.events.push_back(ie);
+		}
+	}
+	return !frames.empty();
+}
+
+/**
+ * Makes frames of one contact moving in circles, at 250 frames a second,
+ * so that each frame moves the cursor.
+ */
+static void generate(Frames &frames) {
+	const int count = 1500;
+	frames.resize(count);
+	for (int i = 0; i < count; ++i) {
+		Frame &f = frames[i];
+		f.when = std::chrono::milliseconds(4 * i);
+		double a = i * 2.0 * M_PI / 200.0;
+		input_event ie = { };
+		ie.type = EV_ABS;
+		if (i == 0) {
+			ie.code = ABS_MT_SLOT;
+			f.events.push_back(ie);
+			ie.code = ABS_MT_TRACKING_ID;
+			ie.value = 1;
+			f.events.push_back(ie);
+		}
+		ie.code = ABS_MT_POSITION_X;
+		ie.value = 2048 + (int)(1000 * std::cos(a));
+		f.events.push_back(ie);
+		ie.code = ABS_MT_POSITION_Y;
+		ie.value = 2048 + (int)(1000 * std::sin(a));
+		f.events.push_back(ie);
+		if (i == count - 1) {
+			ie.code = ABS_MT_TRACKING_ID;
+			ie.value = -1;
+			f.events.push_back(ie);
+		}
+	}
+}
+
+/**
+ * Makes the touchscreen that the recorded input is played through.
+ */
+static libevdev_uinput *makeSource() {
+	libevdev *d = libevdev_new();
+	libevdev_set_name(d, "Screentouch benchmark touchscreen");
+	libevdev_enable_property(d, INPUT_PROP_DIRECT);
+	libevdev_enable_event_type(d, EV_SYN);
+	libevdev_enable_event_type(d, EV_ABS);
+	input_absinfo ai = { };
+	ai.maximum = 9;
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_SLOT, &ai);
+	ai.maximum = 65535;
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_TRACKING_ID, &ai);
+	ai.maximum = 4095;
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_POSITION_X, &ai);
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_POSITION_Y, &ai);
+	libevdev_enable_event_code(d, EV_ABS, ABS_X, &ai);
+	libevdev_enable_event_code(d, EV_ABS, ABS_Y, &ai);
+	ai.maximum = 255;
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_TOUCH_MAJOR, &ai);
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_TOUCH_MINOR, &ai);
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_PRESSURE, &ai);
+	ai.maximum = MT_TOOL_MAX;
+	libevdev_enable_event_code(d, EV_ABS, ABS_MT_TOOL_TYPE, &ai);
+	libevdev_uinput *u = nullptr;
+	int result = libevdev_uinput_create_from_device(d,
+		LIBEVDEV_UINPUT_OPEN_MANAGED, &u);
+	libevdev_free(d);
+	if (result) {
+		BOOST_THROW_EXCEPTION(EvdevUInputCreateError() <<
+			boost::errinfo_errno(-result)
+		);
+	}
+	return u;
+}
+
+/**
+ * Opens a counter of the system calls made by the calling thread.
+ * @return  The counter's file descriptor, or -1 if it is unavailable, as it
+ *          is without the privilege to use tracepoints.
+ */
+static int syscallCounter() {
+	std::ifstream idf("/sys/kernel/tracing/events/raw_syscalls/sys_enter/id");
+	if (!idf) {
+		idf.open("/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id");
+	}
+	std::uint64_t id;
+	if (!(idf >> id)) {
+		return -1;
+	}
+	perf_event_attr pa;
+	std::memset(&pa, 0, sizeof(pa));
+	pa.type = PERF_TYPE_TRACEPOINT;
+	pa.size = sizeof(pa);
+	pa.config = id;
+	pa.disabled = 1;
+	return syscall(__NR_perf_event_open, &pa, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static std::int64_t monotonicNs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (std::int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Translates the frames using the given backend, and reports the system
+ * calls and wakeups per frame on the translating thread, and the time from
+ * writing each input frame to the output frame that followed it.
+ */
+static void run(
+	Poller::Backend backend,
+	libevdev_uinput *source,
+	const Frames &frames
+) {
+	Poller poller(backend);
+	const char *name = (backend == Poller::Uring) ? "io_uring" : "epoll";
+	if (poller.backend() != backend) {
+		std::cout << name << ": unavailable" << std::endl;
+		return;
+	}
+	EvdevShared ev = std::make_shared<Evdev>(
+		libevdev_uinput_get_devnode(source)
+	);
+	ev->grab();
+	ev->usePoller(poller);
+	Transform xf(
+		*ev->absInfo(ABS_MT_POSITION_X),
+		*ev->absInfo(ABS_MT_POSITION_Y)
+	);
+	MtTranslate::Config cfg;
+	UinputSink *us = new UinputSink(xf.xInfo(), xf.yInfo(), cfg.keys());
+	std::unique_ptr<MtTranslate> mt(
+		MtTranslate::make(ev, xf, cfg, OutputSinkPtr(us))
+	);
+	mt->usePoller(poller);
+	// read the output on another thread for the times of its frames
+	int outfd = open(us->devnode(), O_RDONLY | O_CLOEXEC);
+	if (outfd < 0) {
+		BOOST_THROW_EXCEPTION(EvdevFileOpenError() <<
+			boost::errinfo_errno(errno)
+		);
+	}
+	int clk = CLOCK_MONOTONIC;
+	ioctl(outfd, EVIOCSCLOCKID, &clk);
+	std::vector<std::int64_t> inTimes(frames.size()), outTimes;
+	outTimes.reserve(frames.size() * 2);
+	std::atomic<bool> done(false);
+	std::thread reader([&]() {
+		pollfd pfd = { outfd, POLLIN, 0 };
+		while (!done) {
+			if (poll(&pfd, 1, 50) <= 0) {
+				continue;
+			}
+			input_event ie[64];
+			ssize_t size = read(outfd, ie, sizeof(ie));
+			for (int i = 0; i < size / (ssize_t)sizeof(input_event); ++i) {
+				if ((ie[i].type == EV_SYN) && (ie[i].code == SYN_REPORT)) {
+					outTimes.push_back(
+						(std::int64_t)ie[i].input_event_sec * 1000000000 +
+						(std::int64_t)ie[i].input_event_usec * 1000
+					);
+				}
+			}
+		}
+	});
+	std::atomic<bool> played(false);
+	std::thread player([&]() {
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+		for (std::size_t i = 0; i < frames.size(); ++i) {
+			std::this_thread::sleep_until(start + frames[i].when);
+			inTimes[i] = monotonicNs();
+			for (const input_event &ie : frames[i].events) {
+				libevdev_uinput_write_event(source, ie.type, ie.code,
+					ie.value);
+			}
+			libevdev_uinput_write_event(source, EV_SYN, SYN_REPORT, 0);
+		}
+		played = true;
+	});
+	int counter = syscallCounter();
+	rusage before, after;
+	getrusage(RUSAGE_THREAD, &before);
+	if (counter >= 0) {
+		ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	// the main loop of the program, until shortly after the input stops
+	bool ending = false;
+	std::chrono::steady_clock::time_point end;
+	while (!ending || (std::chrono::steady_clock::now() < end)) {
+		std::chrono::milliseconds t = mt->timeout();
+		poller.wait(((t.count() < 0) || (t.count() > 50)) ?
+			std::chrono::milliseconds(50) : t);
+		mt->timeoutHandle();
+		if (!ending && played) {
+			ending = true;
+			end = std::chrono::steady_clock::now() +
+				std::chrono::milliseconds(200);
+		}
+	}
+	std::uint64_t calls = 0;
+	if (counter >= 0) {
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+		if (::read(counter, &calls, sizeof(calls)) != sizeof(calls)) {
+			calls = 0;
+		}
+		close(counter);
+	}
+	getrusage(RUSAGE_THREAD, &after);
+	player.join();
+	done = true;
+	reader.join();
+	close(outfd);
+	// match each output frame with the last input frame written before it
+	std::vector<std::int64_t> lat;
+	std::size_t in = 0;
+	for (std::int64_t out : outTimes) {
+		while ((in + 1 < inTimes.size()) && (inTimes[in + 1] <= out)) {
+			++in;
+		}
+		if (inTimes[in] <= out) {
+			lat.push_back(out - inTimes[in]);
+		}
+	}
+	std::sort(lat.begin(), lat.end());
+	double n = (double)frames.size();
+	std::cout << name << ": " << frames.size() << " input frames, " <<
+	outTimes.size() << " output frames\n  ";
+	if (counter >= 0) {
+		std::cout << calls / n << " system calls per input frame, ";
+	} else {
+		std::cout << "system calls not counted (needs tracepoint access), ";
+	}
+	std::cout << (after.ru_nvcsw - before.ru_nvcsw) / n <<
+	" wakeups per input frame\n";
+	if (!lat.empty()) {
+		std::int64_t sum = 0;
+		for (std::int64_t l : lat) {
+			sum += l;
+		}
+		std::cout << "  latency in microseconds: mean " <<
+		sum / lat.size() / 1000.0 << ", median " <<
+		lat[lat.size() / 2] / 1000.0 << ", 99th percentile " <<
+		lat[lat.size() * 99 / 100] / 1000.0 << ", maximum " <<
+		lat.back() / 1000.0 << std::endl;
+	}
+}
+
+/**
+ * Compares handling input with epoll and with io_uring. Touchscreen input,
+ * either from the flight recorder dump named by the first argument or a
+ * generated stream of cursor motion, is replayed through a uinput device
+ * with its original timing. For each backend, the input is translated like
+ * the main program does and written to another uinput device, which is also
+ * read to time each output frame. Needs permission to use uinput, and to use
+ * tracepoints for counting system calls. The output device moves the
+ * desktop's pointer while running.
+ */
+int main(int argc, char *argv[]) try {
+	Frames frames;
+	if (argc > 1) {
+		if (!load(argv[1], frames)) {
+			std::cerr << "Cannot read the recording " << argv[1] << '.' <<
+			std::endl;
+			return 1;
+		}
+	} else {
+		generate(frames);
+	}
+	libevdev_uinput *source = makeSource();
+	run(Poller::Epoll, source, frames);
+	run(Poller::Uring, source, frames);
+	libevdev_uinput_destroy(source);
+	return 0;
+} catch (...) {
+	std::cerr << "Program failed:\n" <<
+	boost::current_exception_diagnostic_information()
+	<< std::endl;
+	return 3;
+}